@@ -1,30 +1,46 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <unistd.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 
 // comments and definitions of strategies used are sourced from OSTEP #22
 int debug = 0;
-// 32 bit address space used
+// 32 bit address space used, -addrbits takes up to 64
 int addr_size = 32;
-// offset stored using 12 bits in the address
+// offset stored using 12 bits in the address, -pagesize changes it
 int page_frame_size = 12;
 // virtual page number hence, will be stored in the remaining 20 bits
+// every table indexed by page is 1 << page_num_size long; when the page number is
+// wider than page_id_bits (-pageids) pages are numbered densely in order of first
+// touch instead, and page_vpn holds the real page number behind each of those ids.
+// a loaded trace then only gets tables as long as the pages it touches need
 int page_num_size = 20;
-// global clockpointer needed to maintain clock pointer's location for clock eviction strategy
-int clock_pointer = 0;
+int page_id_bits = 22;
+// page_vpn is allocated a chunk at a time and chunks never move, so the event log
+// thread can read it while -stream hands out new ids
+#define PAGE_VPN_CHUNK_BITS 16
+unsigned long long **page_vpn;
 
-struct pte *frames;
+// the parsed trace, shared read-only by every simulation
 struct parsed_line *parsed_lines;
+// next_use[j] holds the index of the next access to the same page after access j
+// (total_accesses if the page is never accessed again), built in one backward pass
+int *next_use;
 
-struct pte {
-    int vpn;
-    int frame_number;
-    int dirty;
-    int valid;
-    int use;
+// per frame access times no strategy looks at, only kept when built with -DFRAME_HISTORY
+// (-1 until the event happens, reset whenever a new page is brought in)
+#ifdef FRAME_HISTORY
+struct frame_history {
     int first_read;
     int last_read;
     int first_write;
@@ -32,10 +48,11 @@ struct pte {
     int brought_in_at;
     int last_used;
 };
+#endif
 
 struct parsed_line {
     int vpn;
-    // int read; // 1 for read, 0 for write
+    int read; // 1 for read, 0 for write
 };
 
 struct accessed_page {
@@ -43,429 +60,3681 @@ struct accessed_page {
     int read;
 };
 
-void print_state(int num_mem_access, int misses, int writes, int drops){
-    printf("Number of memory accesses: %d\nNumber of misses: %d\nNumber of writes: %d\nNumber of drops: %d\n",num_mem_access,misses,writes,drops);
+// doubly linked list over an index space (frames or vpns), the links live in
+// prev/next arrays owned by the policy so one index can be on at most one list
+// at a time per pair of arrays; head is the oldest entry, tail the newest
+struct dlist {
+    int head;
+    int tail;
+    int size;
+};
+
+struct simulation;
+
+// hooks a replacement strategy plugs into the simulation loop, all of them get the
+// accessed page and its position in the trace
+// on_hit: the page is in frame_idx, on_insert: the page was just brought into frame_idx
+typedef void (*access_hook)(struct simulation* sim, int frame_idx, int vpn, int access_idx);
+// memory is full and the page missed, returns the frame to evict
+typedef int (*victim_hook)(struct simulation* sim, int vpn, int access_idx);
+
+struct policy {
+    char* name;
+    // allocates the strategy's own bookkeeping, may be NULL
+    void (*init)(struct simulation* sim);
+    // OPT looks into the future through next_use
+    int needs_next_use;
+    // runs the whole trace, a copy of the simulation loop with this strategy's hooks inlined
+    void (*run)(struct simulation* sim, int total_accesses);
+};
+
+// optional counters for one run, filled in only when -stats is given
+// histograms are power-of-two buckets, bucket b holds values in [2^b, 2^(b+1))
+#define STATS_BUCKETS 32
+#define STATS_DEFAULT_WINDOW 100000
+struct sim_stats {
+    long long read_hits;
+    long long read_misses;
+    long long write_hits;
+    long long write_misses;
+    // frames the CLOCK hand looked at for each eviction, victim included
+    long long clock_sweeps;
+    long long clock_scanned;
+    int clock_max_sweep;
+    long long clock_sweep_hist[STATS_BUCKETS];
+    // LRU stack distance of every access, the number of distinct pages touched
+    // since the last access to the same page (that page included)
+    long long first_touches;
+    long long reuse_hist[STATS_BUCKETS];
+    int *reuse_last;
+    int *reuse_tree;
+    int reuse_tree_size;
+    // misses in every window of window accesses, the last window may be short
+    int window;
+    int num_windows;
+    int *window_misses;
+};
+
+// background write back for -writeback: dirty frames sit on a list in the order they
+// got dirty and the flusher cleans them from the oldest end, one batch at a time
+#define FLUSH_PERIODIC 1
+#define FLUSH_WATERMARK 2
+struct flusher {
+    int mode;
+    // periodic: every period accesses, clean frames dirty for at least expire accesses
+    int period;
+    int expire;
+    int next_flush;
+    // watermark: once more than high frames are dirty, clean down to low
+    int high;
+    int low;
+    struct dlist dirty_list;
+    int *dirty_prev;
+    int *dirty_next;
+    int *dirty_since;
+    int background_writes;
+    int batches;
+};
+
+// one address space of a -tenants trace
+struct tenant {
+    int asid;
+    int accesses;
+    int misses;
+    int writes_to_disk;
+    int drops_non_dirty;
+    // frames holding its pages at the end of the run
+    int resident;
+    // partition: frames set aside for it
+    int quota;
+    // wss: its resident frames in LRU order and the pages it touched in the last tau accesses
+    struct dlist lru;
+    int working_set;
+};
+
+// -tenants numbers every (asid, vpn) pair as a page of its own, densely in order of
+// first touch, so the simulator keeps indexing by vpn; page_tenant maps such a page
+// back to its tenant, tenants are sorted by asid
+struct tenant *tenants;
+int num_tenants;
+int *page_tenant;
+
+// everything one run of a strategy at one frame count needs, so several
+// simulations can run side by side over the same parsed trace
+struct simulation {
+    const struct policy* policy;
+    int num_frames;
+    int is_verbose;
+    // where -verbose and -eventlog send evictions, NULL otherwise
+    struct event_log *event_log;
+    // the frame table, one column per field indexed by frame number, so scans over
+    // use bits or vpns stay in a few cache lines; a frame is free while its vpn is -1
+    int *frame_vpn;
+    char *frame_dirty;
+    char *frame_use;
+#ifdef FRAME_HISTORY
+    struct frame_history *history;
+#endif
+    // page table indexed by vpn, holding the frame the page lives in or -1 if it is not in memory
+    int *page_table;
+    // stack of empty frames, lowest frame no on top so frames are filled in ascending order
+    int *free_frames;
+    int free_frames_count;
+    // clock pointer's location for clock eviction strategy
+    int clock_pointer;
+    // max-heap of frame indices keyed by the next use of the page they hold, for OPT
+    int *opt_heap;
+    int *opt_heap_pos;
+    int *opt_key;
+    // -stream only: the key of pages with no use inside the lookahead window (0 when
+    // the window reaches the end of the trace) and the evictions that had to pick
+    // between two or more such pages, where bounded lookahead may disagree with OPT
+    int opt_horizon;
+    int opt_blind_evictions;
+    // ring buffer of frame indices in the order their pages were brought in, for FIFO
+    int *fifo_queue;
+    int fifo_head;
+    int fifo_count;
+    // intrusive doubly linked recency list over frame indices, for LRU
+    // head is the least recently used frame, tail the most recently used one
+    int *lru_prev;
+    int *lru_next;
+    int lru_head;
+    int lru_tail;
+    // links and list tags for ARC, 2Q and CLOCK-Pro, by frame for resident lists
+    // and by vpn for lists that also remember pages which are no longer resident
+    int *frame_prev;
+    int *frame_next;
+    int *frame_list;
+    int *page_prev;
+    int *page_next;
+    int *page_list;
+    // ARC: resident lists T1/T2, ghost lists B1/B2 and the target size p of T1
+    struct dlist arc_t1;
+    struct dlist arc_t2;
+    struct dlist arc_b1;
+    struct dlist arc_b2;
+    int arc_p;
+    // 2Q: resident FIFO A1in, resident LRU Am and ghost FIFO A1out
+    struct dlist twoq_a1in;
+    struct dlist twoq_am;
+    struct dlist twoq_a1out;
+    // CLOCK-Pro: the three hands over the page clock, for CLOCKPRO-FIFO the FIFO of
+    // resident cold pages standing in for HAND_cold, per page reference and test bits,
+    // the counts of hot and non-resident pages and the cold target mc
+    int cp_hand_hot;
+    int cp_hand_cold;
+    int cp_hand_test;
+    int cp_fifo_cold;
+    struct dlist cp_cold;
+    char *cp_ref;
+    char *cp_test;
+    int cp_hot;
+    int cp_nonresident;
+    int cp_cold_target;
+    // private rand() state, seeded like srand() so RANDOM picks the same victims
+    struct random_data rng;
+    char rng_state[128];
+    // NULL unless the run collects statistics
+    struct sim_stats *stats;
+    // -tenants global replacement charges misses and write backs to these, NULL otherwise
+    struct tenant *tenants;
+    // -writeback's background flusher, NULL otherwise
+    struct flusher *flusher;
+    // meme accesses counts the number of lines basically
+    int mem_accesses;
+    // missess incremented whenever frame not found in memory
+    int misses;
+    // writes to disk incremented at each dirty drop
+    int writes_to_disk;
+    int drops_non_dirty;
+    // evictions incremented at every eviction / frames found full
+    int evictions;
+};
+
+// value of a hex digit, -1 for anything else
+signed char hex_digit[256];
+
+int is_trace_space(char c){
+    return c==' ' || c=='\n' || c=='\t' || c=='\r' || c=='\v' || c=='\f';
 }
 
-void print_verbose_state(int read, int written, int was_dirty){
-    if(was_dirty==1){
-        printf("Page 0x%05x was read from disk, page 0x%05x was written to the disk. \n",read,written);
-    }else if(was_dirty==0){
-        printf("Page 0x%05x was read from disk, page 0x%05x was dropped (it was not dirty). \n",read,written);
-    }else{
-        printf("Error: inaccessible code reached, exiting.. \n");
-        exit(1);
+// binary trace layout, all integers little endian
+// header: "VMTR" | u32 version | u32 page offset bits | u32 flags | u64 number of accesses
+// body: one u64 (vpn << 1 | is_write) per access, or with TRACE_FLAG_VARINT
+// the zigzag encoded difference to the previous record as a LEB128 varint.
+// version 1 traces, with u32 records, are still read
+#define TRACE_MAGIC "VMTR"
+#define TRACE_VERSION 2
+#define TRACE_HEADER_SIZE 24
+#define TRACE_FLAG_VARINT 1
+
+unsigned get_u32(const unsigned char* p){
+    return (unsigned)p[0] | ((unsigned)p[1] << 8) | ((unsigned)p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+void put_u32(unsigned char* p, unsigned v){
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+unsigned long long get_u64(const unsigned char* p){
+    return get_u32(p) | ((unsigned long long)get_u32(p + 4) << 32);
+}
+
+void put_u64(unsigned char* p, unsigned long long v){
+    put_u32(p, (unsigned)v);
+    put_u32(p + 4, (unsigned)(v >> 32));
+}
+
+// dense numbering of page numbers too wide to index a table with
+struct id_map {
+    unsigned long long *keys;
+    int *ids;
+    int bits;
+    int count;
+};
+
+void init_id_map(struct id_map* map, int bits){
+    map->bits = bits;
+    map->count = 0;
+    map->keys = (unsigned long long*)malloc((1ULL << bits) * sizeof(unsigned long long));
+    map->ids = (int*)malloc((1ULL << bits) * sizeof(int));
+    for(long long h=0; h<(1LL << bits); h++){
+        map->ids[h] = -1;
     }
 }
 
-int execute_opt(char* trace_file_name, int num_frames, int start_access, int total_accesses){
-    if(debug==1) printf("Performing OPT.... \n");
-    int evict_idx = -1;
-    int overall_last_access = -1;
-    for(int i=0; i<num_frames; i++){
-        int curr_vpn = frames[i].vpn;
-        int access_time = -1;
-        int access_count = 0;
-        for(int j=start_access; j<total_accesses; j++){
-            access_count++;
-            if(parsed_lines[j].vpn == curr_vpn){
-                access_time = access_count;
-                if(access_time > overall_last_access){
-                    overall_last_access = access_time;
-                    evict_idx = i;
-                }
-                break;
-            }
-        }
-        // this page has not been accessed in the future at all
-        // in such cases, evict smallest frame no
-        // as we are iterating frames in ascending order, evict this frame itself
-        if(access_time==-1){
-            return i;
-        }
+// slot of key, or the empty slot it would go in
+static inline unsigned long long id_map_slot(struct id_map* map, unsigned long long key){
+    unsigned long long mask = (1ULL << map->bits) - 1;
+    unsigned long long h = (key * 0x9E3779B97F4A7C15ULL) >> (64 - map->bits);
+    while(map->ids[h] != -1 && map->keys[h] != key){
+        h = (h + 1) & mask;
     }
-    return evict_idx;
-// The optimal replacement policy
-// leads to the fewest number of misses overall. 
-// Belady showed that a simple (but, unfortunately, difficult to implement!) 
-// approach that replaces the page that will be 
-// accessed furthest in the future is the optimal policy,
-// resulting in the fewest-possible cache misses.
+    return h;
 }
 
-int execute_fifo(int num_frames){
-    if(debug==1) printf("Performing FIFO.... \n");
-    // FIFO (first-in, first-out) replacement, where pages
-    // were simply placed in a queue when they enter the system; when a replacement occurs, the page on the tail of the queue (the “first-in” page) is
-    // evicted. FIFO has one great strength: it is quite simple to implement.
-    int evict_idx = 0;
-    int first_in = frames[0].brought_in_at;
-    assert(first_in != -1 && "brought in at should not be -1, as frame is in the memory hence must be brought in at some point");
-    for(int i=1; i<num_frames; i++){
-        assert(frames[i].brought_in_at != -1 && "brought in at should not be -1, as frame is in the memory hence must be brought in at some point");
-        if(frames[i].brought_in_at < first_in){
-            first_in = frames[i].brought_in_at;
-            evict_idx = i;
-        }
+// doubles the table, the ids stay the same
+void grow_id_map(struct id_map* map){
+    unsigned long long *keys = map->keys;
+    int *ids = map->ids;
+    long long old_size = 1LL << map->bits;
+    int count = map->count;
+    init_id_map(map, map->bits + 1);
+    map->count = count;
+    for(long long h=0; h<old_size; h++){
+        if(ids[h] == -1) continue;
+        unsigned long long slot = id_map_slot(map, keys[h]);
+        map->keys[slot] = keys[h];
+        map->ids[slot] = ids[h];
     }
-    return evict_idx;
+    free(keys);
+    free(ids);
 }
 
-// where to begin?
-// how to update begin after evict inde return?
-// piazza doubt?
-int execute_clock(int num_frames){
-// How does the OS employ the use bit to approximate LRU? Well, there
-// could be a lot of ways, but with the clock algorithm, one simple
-// approach was suggested. Imagine all the pages of the system arranged in
-// a circular list. A clock hand points to some particular page to begin with
-// (it doesn’t really matter which). When a replacement must occur, the OS
-// checks if the currently-pointed to page P has a use bit of 1 or 0. If 1, this
-// implies that page P was recently used and thus is not a good candidate
-// for replacement. Thus, the use bit for P is set to 0 (cleared), and the clock
-// hand is incremented to the next page (P + 1). The algorithm continues
-// until it finds a use bit that is set to 0, implying this page has not been
-// recently used (or, in the worst case, that all pages have been and that we
-// have now searched through the entire set of pages, clearing all the bits).
-    if(debug==1) printf("Performing CLOCK.... \n");
-    int start_pointer = clock_pointer;
-    int evict_idx_temp = -1;
-    if(frames[clock_pointer].use == 1) {
-            frames[clock_pointer].use = 0;
-            clock_pointer = (clock_pointer + 1) % num_frames;
+// id of key, a new one if it hasn't been seen, -1 once limit ids are handed out;
+// the table doubles whenever it would get more than half full
+int map_id(struct id_map* map, unsigned long long key, int limit){
+    unsigned long long h = id_map_slot(map, key);
+    if(map->ids[h] != -1) return map->ids[h];
+    if(map->count == limit) return -1;
+    if(2LL * (map->count + 1) > (1LL << map->bits)){
+        grow_id_map(map);
+        h = id_map_slot(map, key);
     }
-    while(start_pointer != clock_pointer){
-        if(frames[clock_pointer].use == 1) {
-            frames[clock_pointer].use = 0;
-            clock_pointer = (clock_pointer + 1) % num_frames;
-            continue;
+    map->keys[h] = key;
+    map->ids[h] = map->count;
+    return map->count++;
+}
+
+struct id_map page_ids;
+
+// sizes the page tables for the configured address and page size
+void configure_pages(){
+    page_num_size = addr_size - page_frame_size;
+    if(page_num_size > page_id_bits){
+        page_num_size = page_id_bits;
+        page_vpn = (unsigned long long**)calloc(((1 << page_id_bits) >> PAGE_VPN_CHUNK_BITS) + 1, sizeof(unsigned long long*));
+        init_id_map(&page_ids, 10);
+    }
+}
+
+// once a whole trace is loaded the tables only need to cover the ids handed out
+void fit_page_ids(){
+    if(page_vpn == NULL) return;
+    page_num_size = 1;
+    while((1 << page_num_size) < page_ids.count) page_num_size++;
+}
+
+// the index the tables use for a page
+static inline int page_id(unsigned long long vpn){
+    if(page_vpn == NULL){
+        if((vpn >> page_num_size) != 0){
+            printf("Page 0x%llx is outside the %d bit address space, exiting.. \n", vpn, addr_size);
+            exit(1);
         }
-        evict_idx_temp = clock_pointer;
-        clock_pointer = (clock_pointer + 1) % num_frames;
-        return evict_idx_temp % num_frames;
-    } 
-    evict_idx_temp = clock_pointer;
-    clock_pointer = (clock_pointer + 1) % num_frames;
-    return (evict_idx_temp)%num_frames;
+        return (int)vpn;
+    }
+    int known = page_ids.count;
+    int id = map_id(&page_ids, vpn, 1 << page_id_bits);
+    if(id == -1){
+        printf("Trace touches more than %d distinct pages, pass a larger -pageids, exiting.. \n", 1 << page_id_bits);
+        exit(1);
+    }
+    // only a new id is written; the event log thread reads page_vpn of ids it has
+    // been handed, which all exist before the event referencing them is queued
+    if(page_ids.count != known){
+        unsigned long long **chunk = &page_vpn[id >> PAGE_VPN_CHUNK_BITS];
+        if(*chunk == NULL) *chunk = (unsigned long long*)malloc((1 << PAGE_VPN_CHUNK_BITS) * sizeof(unsigned long long));
+        (*chunk)[id & ((1 << PAGE_VPN_CHUNK_BITS) - 1)] = vpn;
+    }
+    return id;
 }
 
-int execute_lru(int num_frames){
-    //  printf("Performing LRU.... \n");
-    //  Similarly, the Least-Recently Used (LRU) policy replaces the least-recently-used page.
-    int evict_idx = 0;
-    int last_used = frames[0].last_used;
-    if(frames[0].last_used == -1){
-        last_used = frames[0].last_used;
+// the page number behind a table index
+static inline unsigned long long page_number(int id){
+    if(page_vpn == NULL) return (unsigned long long)id;
+    return page_vpn[id >> PAGE_VPN_CHUNK_BITS][id & ((1 << PAGE_VPN_CHUNK_BITS) - 1)];
+}
+
+// records are stored as (vpn << 1 | is_write); pages are at least 2 bytes, so any
+// 64 bit address leaves a vpn that fits
+unsigned long long pack_record(unsigned long long vpn, int read){
+    return (vpn << 1) | (read == 1 ? 0 : 1);
+}
+
+void unpack_record(unsigned long long record, struct parsed_line* line){
+    line->vpn = page_id(record >> 1);
+    line->read = (record & 1) == 0;
+}
+
+// every "<hex address> <R|W>" record is scanned by hand,
+// anything other than R is treated as a write like before
+void init_hex_digits(){
+    for(int c=0; c<256; c++){
+        hex_digit[c] = -1;
+    }
+    for(int c='0'; c<='9'; c++) hex_digit[c] = c - '0';
+    for(int c='a'; c<='f'; c++) hex_digit[c] = c - 'a' + 10;
+    for(int c='A'; c<='F'; c++) hex_digit[c] = c - 'A' + 10;
+}
+
+// an address with bits above addr_size would alias another page, so stop instead of
+// dropping them; overflowed is set when the hex digits didn't even fit in 64 bits
+void check_address(unsigned long long virt_mem_addr, int overflowed, long long line){
+    if(overflowed){
+        printf("Address on trace line %lld does not fit in 64 bits, exiting.. \n", line);
+        exit(1);
     }
-    if(frames[0].last_used != -1 && frames[0].last_used < last_used){
-        last_used = frames[0].last_used;
+    if(addr_size < 64 && (virt_mem_addr >> addr_size) != 0){
+        printf("Address on trace line %lld is wider than %d bits, pass a larger -addrbits, exiting.. \n", line, addr_size);
+        exit(1);
     }
-    assert(last_used != -1 && "last used should not be -1, as frame is in the memory hence must be accessed at some point");
-    for(int i=1; i<num_frames; i++){
-        if(frames[i].last_used != -1 && frames[i].last_used < last_used){
-            last_used = frames[i].last_used;
-            evict_idx = i;
+}
+
+int parse_text_trace(const char* buf, size_t size){
+    init_hex_digits();
+    int capacity = 1024;
+    int count = 0;
+    parsed_lines = (struct parsed_line*)malloc(capacity * sizeof(struct parsed_line));
+    size_t pos = 0;
+    while(1){
+        while(pos < size && is_trace_space(buf[pos])) pos++;
+        if(pos == size) break;
+        if(buf[pos] == '0' && pos + 1 < size && (buf[pos+1] == 'x' || buf[pos+1] == 'X')) pos += 2;
+        size_t digits_start = pos;
+        unsigned long long virt_mem_addr = 0;
+        int overflowed = 0;
+        while(pos < size && hex_digit[(unsigned char)buf[pos]] >= 0){
+            if(virt_mem_addr >> 60 != 0) overflowed = 1;
+            virt_mem_addr = (virt_mem_addr << 4) | hex_digit[(unsigned char)buf[pos]];
+            pos++;
+        }
+        int no_digits = (pos == digits_start);
+        while(pos < size && is_trace_space(buf[pos])) pos++;
+        if(no_digits || pos == size){
+            printf("Malformed trace line %d, exiting.. \n", count + 1);
+            exit(1);
         }
+        char read_or_write = buf[pos++];
+        if(count == capacity){
+            capacity *= 2;
+            parsed_lines = (struct parsed_line*)realloc(parsed_lines, capacity * sizeof(struct parsed_line));
+        }
+        check_address(virt_mem_addr, overflowed, count + 1);
+        parsed_lines[count].vpn = page_id(virt_mem_addr >> page_frame_size);
+        parsed_lines[count].read = (read_or_write=='R');
+        count++;
     }
-    return evict_idx;
+    return count;
 }
 
-int execute_random(int num_frames){
-    // printf("Performing RANDOM.... \n");
-    // simply picks a random page to replace under memory pressure
-    int idx = rand() % num_frames;
-    return idx;
+// validates a binary trace header, returns the number of accesses it announces;
+// record_bytes is the size of an unencoded record, 4 for version 1 and 8 after that
+unsigned long long check_trace_header(const unsigned char* buf, unsigned* flags, int* record_bytes){
+    unsigned version = get_u32(buf + 4);
+    unsigned offset_bits = get_u32(buf + 8);
+    *flags = get_u32(buf + 12);
+    *record_bytes = version == 1 ? 4 : 8;
+    if(version != 1 && version != TRACE_VERSION){
+        printf("Unsupported binary trace version %u, exiting.. \n", version);
+        exit(1);
+    }
+    if((int)offset_bits != page_frame_size){
+        printf("Binary trace was written for %u offset bits, simulator uses %d, exiting.. \n", offset_bits, page_frame_size);
+        exit(1);
+    }
+    return get_u64(buf + 16);
 }
 
-int main(int argc, char** argv)
-{
-    int seed = 5635;
-    srand(seed);
-    char* OPT = "OPT";
-    char* FIFO = "FIFO";
-    char* CLOCK = "CLOCK";
-    char* LRU = "LRU";
-    char* RANDOM = "RANDOM";
-    char* verbose = "-verbose";
-    // 2nd argument will be the name of the trace file 
-    char* trace_file_name = argv[1];
-    int num_frames = atoi(argv[2]);
-    if(num_frames<0 || num_frames>1000){
-        printf("Invalid number of frames \n");
+int parse_binary_trace(const unsigned char* buf, size_t size){
+    unsigned flags;
+    int record_bytes;
+    unsigned long long total = check_trace_header(buf, &flags, &record_bytes);
+    if(total > 0x7fffffff){
+        printf("Binary trace has too many accesses, exiting.. \n");
+        exit(1);
     }
-    char* strategy = argv[3];
-    int is_verbose = 0;
-    // verbose will be the 5th argument, if it is present 
-    // sanity check to check if it is indeed verbose, set verbose flag to true
-    if(argc==5){
-        if(strcmp(verbose, argv[4])==0){
-            is_verbose = 1;
+    int count = (int)total;
+    parsed_lines = (struct parsed_line*)malloc((count > 0 ? count : 1) * sizeof(struct parsed_line));
+    const unsigned char* p = buf + TRACE_HEADER_SIZE;
+    const unsigned char* end = buf + size;
+    if((flags & TRACE_FLAG_VARINT) == 0){
+        if((size_t)(end - p) < (size_t)count * record_bytes){
+            printf("Binary trace is truncated, exiting.. \n");
+            exit(1);
         }
+        for(int j=0; j<count; j++){
+            const unsigned char* r = p + (size_t)record_bytes * j;
+            unpack_record(record_bytes == 4 ? get_u32(r) : get_u64(r), &parsed_lines[j]);
+        }
+        return count;
     }
-    // printf("Is verbose %d \n", is_verbose);
-    int line_counter = 0;
-    int counter_loop_exit = 0;
-    FILE* file_ptr_counter = fopen(trace_file_name, "r");
-    // read line and update these 2 parameters at each iteration
-    char read_or_write;
-    unsigned virt_mem_addr;
-    while(counter_loop_exit == 0){
-        if(EOF == fscanf(file_ptr_counter, "%x %c", &virt_mem_addr, &read_or_write)){
-            counter_loop_exit=1;
-        }else{
-           line_counter++;
-        }
-    }
-    fclose(file_ptr_counter);
-    int total_accesses = line_counter;
-    parsed_lines = (struct parsed_line*)malloc(line_counter * sizeof(struct parsed_line));
-    counter_loop_exit = 0;
-    line_counter = 0;
-    FILE* file_ptr_counter2 = fopen(trace_file_name, "r");
-    while(counter_loop_exit == 0){
-        if(EOF == fscanf(file_ptr_counter2, "%x %c", &virt_mem_addr, &read_or_write)){
-            counter_loop_exit=1;
-        }else{
-            parsed_lines[line_counter].vpn = (virt_mem_addr >> page_frame_size);
-            // parsed_lines[line_counter].read = (read_or_write=='R');
-            line_counter++;
+    unsigned long long prev = 0;
+    for(int j=0; j<count; j++){
+        unsigned long long zigzag = 0;
+        int shift = 0;
+        while(1){
+            if(p == end || shift > 63){
+                printf("Binary trace is truncated, exiting.. \n");
+                exit(1);
+            }
+            unsigned char byte = *p++;
+            zigzag |= (unsigned long long)(byte & 0x7f) << shift;
+            if((byte & 0x80) == 0) break;
+            shift += 7;
         }
+        prev += (zigzag >> 1) ^ -(zigzag & 1);
+        // version 1 differences wrapped around at 32 bits
+        if(record_bytes == 4) prev &= 0xffffffffULL;
+        unpack_record(prev, &parsed_lines[j]);
     }
-    fclose(file_ptr_counter2);
-    FILE* file_ptr = fopen(trace_file_name, "r");
-    if(file_ptr==NULL){
-        printf("File not found, exiting.. \n");
-        exit(1);
+    return count;
+}
+
+// "<asid> <hex address> <R|W>" records, asid in decimal
+int parse_tenant_trace(const char* buf, size_t size){
+    init_hex_digits();
+    int hash_bits = page_num_size + 1;
+    int hash_size = 1 << hash_bits;
+    // open addressing over (asid, vpn), empty while hash_page is -1
+    unsigned long long *hash_vpn = (unsigned long long*)malloc(hash_size * sizeof(unsigned long long));
+    int *hash_asid = (int*)malloc(hash_size * sizeof(int));
+    int *hash_page = (int*)malloc(hash_size * sizeof(int));
+    for(int h=0; h<hash_size; h++){
+        hash_page[h] = -1;
     }
-    frames = (struct pte*)malloc(num_frames * sizeof(struct pte));
-    for(int i=0; i<num_frames; i++){
-        frames[i].vpn = -1;
-        frames[i].frame_number = i;
-        frames[i].dirty = 0;
-        frames[i].valid = 0;
-        frames[i].use = -1;
-        frames[i].first_read = -1;
-        frames[i].last_read = -1;
-        frames[i].first_write = -1;
-        frames[i].last_write = -1;
-        frames[i].brought_in_at = -1;
-        frames[i].last_used = -1;
-    }
-    int loop_exit = 0;
-    // meme accesses counts the number of lines basically
-    int mem_accesses = 0;
-    // writes to disk incremented at each dirty drop
-    int writes_to_disk = 0;
-    int drops_non_dirty = 0;
-    // evictions incremented at every eviction / frames found full
-    int evictions = 0;
-    // missess incremented whenever frame not found in memory
-    int misses = 0;
-    int last_evicted_index = -1;
-    while(loop_exit == 0){
-        if(EOF == fscanf(file_ptr, "%x %c", &virt_mem_addr, &read_or_write)){
-            loop_exit=1;
-        }else{
-            mem_accesses++;
-        }
-        int page_num_acc = virt_mem_addr >> page_frame_size;
-        if(read_or_write == 'R'){
-            // READ case
-            int page_found_in_mem = 0;
-            int empty_frame_idx = -1;
-            for(int i=0; i<num_frames; i++){
-                if(frames[i].vpn == page_num_acc){
-                    // Page found in memory
-                    page_found_in_mem = 1;
-                    assert(frames[i].valid == 1 && "page in mem, valid bit should be 1");
-                    if(frames[i].first_read==-1){
-                        frames[i].first_read = mem_accesses - 1;
-                        frames[i].last_read = mem_accesses - 1;
-                    }else{
-                        frames[i].last_read = mem_accesses - 1;
-                    }
-                    frames[i].last_used = mem_accesses - 1;
-                    frames[i].use = 1;
-                    break;
-                }else if(frames[i].vpn==-1 && empty_frame_idx == -1){
-                    empty_frame_idx = i;
+    int num_pages = 0;
+    page_tenant = (int*)malloc((1 << page_num_size) * sizeof(int));
+    int tenant_capacity = 16;
+    tenants = (struct tenant*)malloc(tenant_capacity * sizeof(struct tenant));
+    num_tenants = 0;
+    int last_tenant = -1;
+    int capacity = 1024;
+    int count = 0;
+    parsed_lines = (struct parsed_line*)malloc(capacity * sizeof(struct parsed_line));
+    size_t pos = 0;
+    while(1){
+        while(pos < size && is_trace_space(buf[pos])) pos++;
+        if(pos == size) break;
+        size_t asid_start = pos;
+        long long asid = 0;
+        while(pos < size && buf[pos] >= '0' && buf[pos] <= '9' && asid <= 0x7fffffff){
+            asid = asid * 10 + (buf[pos] - '0');
+            pos++;
+        }
+        int bad = (pos == asid_start) || asid > 0x7fffffff;
+        while(pos < size && is_trace_space(buf[pos])) pos++;
+        if(pos < size && buf[pos] == '0' && pos + 1 < size && (buf[pos+1] == 'x' || buf[pos+1] == 'X')) pos += 2;
+        size_t digits_start = pos;
+        unsigned long long virt_mem_addr = 0;
+        int overflowed = 0;
+        while(pos < size && hex_digit[(unsigned char)buf[pos]] >= 0){
+            if(virt_mem_addr >> 60 != 0) overflowed = 1;
+            virt_mem_addr = (virt_mem_addr << 4) | hex_digit[(unsigned char)buf[pos]];
+            pos++;
+        }
+        bad = bad || (pos == digits_start);
+        while(pos < size && is_trace_space(buf[pos])) pos++;
+        if(bad || pos == size){
+            printf("Malformed trace line %d, exiting.. \n", count + 1);
+            exit(1);
+        }
+        char read_or_write = buf[pos++];
+        // consecutive lines mostly come from the same tenant
+        int t = last_tenant;
+        if(t == -1 || tenants[t].asid != asid){
+            for(t=0; t<num_tenants && tenants[t].asid != asid; t++);
+            if(t == num_tenants){
+                if(num_tenants == tenant_capacity){
+                    tenant_capacity *= 2;
+                    tenants = (struct tenant*)realloc(tenants, tenant_capacity * sizeof(struct tenant));
                 }
+                memset(&tenants[t], 0, sizeof(struct tenant));
+                tenants[t].asid = (int)asid;
+                num_tenants++;
             }
-            if(page_found_in_mem == 0){
-                if(debug==1) printf("READ - Missed page %d in memory at access %d \n", page_num_acc, mem_accesses);
-                misses++;
-                if(empty_frame_idx == -1){
-                    evictions++;
-                    // no empty frame left, will have to evict some frame
-                    // find index of frame to evict according to whatever strategy is being used
-                    int evict_idx = -1;
-                    if(strcmp(strategy,OPT)==0){
-                        evict_idx = execute_opt(trace_file_name, num_frames, mem_accesses, total_accesses);
-                    }else if(strcmp(strategy, FIFO)==0){
-                        evict_idx = execute_fifo(num_frames);
-                    }else if(strcmp(strategy, CLOCK)==0){
-                        evict_idx = execute_clock(num_frames);
-                    }else if(strcmp(strategy, LRU)==0){
-                        evict_idx = execute_lru(num_frames);
-                    }else if(strcmp(strategy, RANDOM)==0){
-                        evict_idx = execute_random(num_frames);
-                    }else{
-                        printf("Unknown strategy entered, exiting .... \n");
-                        exit(1);
-                    }
-                    assert(evict_idx!=-1);
-                    last_evicted_index = evict_idx;
-                    if(debug==1) printf("Evicting %d, is  dirty %d \n",frames[evict_idx].vpn,frames[evict_idx].dirty);
-                    if(frames[evict_idx].dirty==1){
-                        if(debug==1) printf("dirty drop page %d\n", frames[evict_idx].vpn);
-                        writes_to_disk++;
-                        // evicting dirty page, print state accordingly
-                        // evicting frames[evict_idx].vpn, bringing in page_num_acc
-                        if(is_verbose==1){
-                            print_verbose_state(page_num_acc, frames[evict_idx].vpn, 1);
-                        }
-                    }else{
-                        if(debug==1) printf("Non dirty drop page %d\n", frames[evict_idx].vpn);
-                        drops_non_dirty++;
-                        // evicted page was not dirty
-                        // evicting frames[evict_idx].vpn, bringing in page_num_acc
-                        if(is_verbose==1){
-                            print_verbose_state(page_num_acc, frames[evict_idx].vpn, 0);
-                        }
-                    }
-                    // simulating bringing the page in from memory ...
-                    if(debug==1) printf("page number %d is at frame no. %d \n", page_num_acc, evict_idx);
-                    frames[evict_idx].vpn = page_num_acc;
-                    frames[evict_idx].brought_in_at = mem_accesses - 1;
-                    frames[evict_idx].use = 1;
-                    frames[evict_idx].frame_number = evict_idx;
-                    frames[evict_idx].valid = 1;
-                    frames[evict_idx].first_read = mem_accesses - 1;
-                    frames[evict_idx].last_read = mem_accesses - 1;
-                    frames[evict_idx].first_write = -1;
-                    frames[evict_idx].last_write = -1;
-                    frames[evict_idx].dirty = 0;
-                    frames[evict_idx].last_used = mem_accesses - 1;
-                }else{
-                    // simulating bringing the page in from memory ...
-                    // set page num to empty idx page frame
-                    assert(empty_frame_idx != -1 && "empty frame index can't be -1");
-                    if(debug==1) printf("page number %d is at frame no. %d \n", page_num_acc, empty_frame_idx);
-                    frames[empty_frame_idx].vpn = page_num_acc;
-                    frames[empty_frame_idx].frame_number = empty_frame_idx;
-                    frames[empty_frame_idx].brought_in_at = mem_accesses - 1;
-                    frames[empty_frame_idx].use = 1;
-                    frames[empty_frame_idx].valid = 1;
-                    frames[empty_frame_idx].first_read = mem_accesses - 1;
-                    frames[empty_frame_idx].last_read = mem_accesses - 1;
-                    frames[empty_frame_idx].first_write = -1;
-                    frames[empty_frame_idx].last_write = -1;
-                    frames[empty_frame_idx].dirty = 0;
-                    frames[empty_frame_idx].last_used = mem_accesses - 1;
+            last_tenant = t;
+        }
+        check_address(virt_mem_addr, overflowed, count + 1);
+        unsigned long long vpn = virt_mem_addr >> page_frame_size;
+        int h = (int)(((vpn ^ ((unsigned long long)asid << 40)) * 0x9E3779B97F4A7C15ULL) >> (64 - hash_bits));
+        while(hash_page[h] != -1 && (hash_vpn[h] != vpn || hash_asid[h] != asid)){
+            h = (h + 1) & (hash_size - 1);
+        }
+        if(hash_page[h] == -1){
+            if(num_pages == (1 << page_num_size)){
+                printf("Tenants touch more than %d pages together, exiting.. \n", 1 << page_num_size);
+                exit(1);
+            }
+            hash_vpn[h] = vpn;
+            hash_asid[h] = (int)asid;
+            hash_page[h] = num_pages;
+            page_tenant[num_pages] = t;
+            num_pages++;
+        }
+        if(count == capacity){
+            capacity *= 2;
+            parsed_lines = (struct parsed_line*)realloc(parsed_lines, capacity * sizeof(struct parsed_line));
+        }
+        parsed_lines[count].vpn = hash_page[h];
+        parsed_lines[count].read = (read_or_write=='R');
+        tenants[t].accesses++;
+        count++;
+    }
+    free(hash_vpn);
+    free(hash_asid);
+    free(hash_page);
+    // number the tenants by asid, so reports and -quota lists follow asid order
+    int *rank = (int*)malloc((num_tenants > 0 ? num_tenants : 1) * sizeof(int));
+    for(int t=0; t<num_tenants; t++){
+        rank[t] = 0;
+        for(int u=0; u<num_tenants; u++){
+            if(tenants[u].asid < tenants[t].asid) rank[t]++;
+        }
+    }
+    struct tenant *sorted = (struct tenant*)malloc((num_tenants > 0 ? num_tenants : 1) * sizeof(struct tenant));
+    for(int t=0; t<num_tenants; t++){
+        sorted[rank[t]] = tenants[t];
+    }
+    for(int v=0; v<num_pages; v++){
+        page_tenant[v] = rank[page_tenant[v]];
+    }
+    free(tenants);
+    free(rank);
+    tenants = sorted;
+    return count;
+}
+
+// with_tenants reads the "<asid> <hex address> <R|W>" text format of -tenants instead
+int read_trace_file(char* trace_file_name, int with_tenants){
+    int fd = open(trace_file_name, O_RDONLY);
+    if(fd < 0){
+        printf("File not found, exiting.. \n");
+        exit(1);
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0){
+        printf("Could not stat trace file, exiting.. \n");
+        exit(1);
+    }
+    size_t size = st.st_size;
+    const char* buf = NULL;
+    if(size > 0){
+        buf = (const char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(buf == MAP_FAILED){
+            printf("Could not map trace file, exiting.. \n");
+            exit(1);
+        }
+        madvise((void*)buf, size, MADV_SEQUENTIAL);
+    }
+    int count;
+    if(with_tenants == 1){
+        count = parse_tenant_trace(buf, size);
+    }else if(size >= TRACE_HEADER_SIZE && memcmp(buf, TRACE_MAGIC, 4) == 0){
+        count = parse_binary_trace((const unsigned char*)buf, size);
+    }else{
+        count = parse_text_trace(buf, size);
+    }
+    if(with_tenants == 0) fit_page_ids();
+    if(size > 0) munmap((void*)buf, size);
+    close(fd);
+    return count;
+}
+
+// reads the whole trace into parsed_lines in one pass and returns the number of accesses
+// the file is mmapped and parsed as a binary trace if it starts with TRACE_MAGIC, as text otherwise
+int load_trace(char* trace_file_name){
+    return read_trace_file(trace_file_name, 0);
+}
+
+// incremental reader for -stream, takes the same text and binary formats as
+// load_trace but only ever holds one read buffer of the input
+struct trace_stream {
+    FILE* in;
+    unsigned char buf[1 << 16];
+    size_t len;
+    size_t pos;
+    int is_binary;
+    int is_varint;
+    int record_bytes;
+    unsigned long long prev;
+    // set once the input has run out
+    int finished;
+    long long records;
+};
+
+// next byte of the input, -1 at the end
+static inline int stream_getc(struct trace_stream* ts){
+    if(ts->pos == ts->len){
+        ts->len = fread(ts->buf, 1, sizeof(ts->buf), ts->in);
+        ts->pos = 0;
+        if(ts->len == 0) return -1;
+    }
+    return ts->buf[ts->pos++];
+}
+
+void open_trace_stream(struct trace_stream* ts, FILE* in){
+    memset(ts, 0, sizeof(struct trace_stream));
+    ts->in = in;
+    init_hex_digits();
+    // a pipe can hand over less than asked for, keep reading until the header is in
+    while(ts->len < TRACE_HEADER_SIZE){
+        size_t got = fread(ts->buf + ts->len, 1, TRACE_HEADER_SIZE - ts->len, in);
+        if(got == 0) break;
+        ts->len += got;
+    }
+    if(ts->len == TRACE_HEADER_SIZE && memcmp(ts->buf, TRACE_MAGIC, 4) == 0){
+        unsigned flags;
+        check_trace_header(ts->buf, &flags, &ts->record_bytes);
+        ts->is_binary = 1;
+        ts->is_varint = (flags & TRACE_FLAG_VARINT) != 0;
+        ts->pos = TRACE_HEADER_SIZE;
+    }
+}
+
+// one record into line, 0 at the end of the input
+int read_stream_record(struct trace_stream* ts, struct parsed_line* line){
+    int c;
+    if(ts->is_binary == 1){
+        unsigned long long record = 0;
+        if(ts->is_varint == 0){
+            for(int b=0; b<ts->record_bytes; b++){
+                c = stream_getc(ts);
+                if(c < 0){
+                    if(b == 0) return 0;
+                    printf("Binary trace is truncated, exiting.. \n");
+                    exit(1);
                 }
+                record |= (unsigned long long)c << (8 * b);
             }
         }else{
-            // WRITE case
-            int page_found_in_mem = 0;
-            int empty_frame_idx = -1;
-            for(int i=0; i<num_frames; i++){
-                if(frames[i].vpn == page_num_acc){
-                    // Page found in memory, make it dirty
-                    page_found_in_mem = 1;
-                    assert(frames[i].valid == 1 && "page in mem, valid bit should be 1");
-                    if(debug==1) printf("Writing %d, now DIRTY \n", frames[i].vpn);
-                    frames[i].dirty = 1;
-                    if(frames[i].first_write == -1){
-                        frames[i].first_write = mem_accesses - 1;
-                        frames[i].last_write = mem_accesses - 1;
-                    }else{
-                        frames[i].last_write = mem_accesses - 1;
-                    }
-                    frames[i].last_used = mem_accesses - 1;
-                    frames[i].use = 1;
-                    break;
-                }else if(frames[i].vpn==-1 && empty_frame_idx == -1){
-                    empty_frame_idx = i;
+            unsigned long long zigzag = 0;
+            int shift = 0;
+            while(1){
+                c = stream_getc(ts);
+                if(c < 0 && shift == 0) return 0;
+                if(c < 0 || shift > 63){
+                    printf("Binary trace is truncated, exiting.. \n");
+                    exit(1);
                 }
+                zigzag |= (unsigned long long)(c & 0x7f) << shift;
+                if((c & 0x80) == 0) break;
+                shift += 7;
             }
-            // page not found in memory
-            if(page_found_in_mem == 0){
-                if(debug==1) printf("WRITE - Missed page %d in memory at access %d \n", page_num_acc, mem_accesses);
-                misses++;
-                // if all frames are full
-                if(empty_frame_idx == -1){
-                    evictions++;
-                    // no empty frame left, will have to evict some frame
-                    // find index of frame to evict according to whatever strategy is being used
-                    int evict_idx = -1;
-                    if(strcmp(strategy,OPT)==0){
-                        evict_idx = execute_opt(trace_file_name, num_frames, mem_accesses, total_accesses);
-                    }else if(strcmp(strategy, FIFO)==0){
-                        evict_idx = execute_fifo(num_frames);
-                    }else if(strcmp(strategy, CLOCK)==0){
-                        evict_idx = execute_clock(num_frames);
-                    }else if(strcmp(strategy, LRU)==0){
-                        evict_idx = execute_lru(num_frames);
-                    }else if(strcmp(strategy, RANDOM)==0){
-                        evict_idx = execute_random(num_frames);
-                    }else{
-                        printf("Unknown strategy entered, exiting .... \n");
-                        exit(1);
-                    }
-                    last_evicted_index = evict_idx;
-                    if(debug==1) printf("Evicting %d, is  dirty %d \n",frames[evict_idx].vpn,frames[evict_idx].dirty);
-                    if(frames[evict_idx].dirty==1){
-                        writes_to_disk++;
-                        if(debug==1) printf("dirty drop page %d\n", frames[evict_idx].vpn);
-                        // evicting dirty page, print state accordingly
-                        // evicting frames[evict_idx].vpn, bringing in page_num_acc
-                        if(is_verbose==1){
-                            print_verbose_state(page_num_acc, frames[evict_idx].vpn, 1);
-                        }
-                    }else{
-                        drops_non_dirty++;
-                        if(debug==1) printf("Non dirty drop page %d\n", frames[evict_idx].vpn);
-                        // evicted page was not dirty
-                        // evicting frames[evict_idx].vpn, bringing in page_num_acc
-                        if(is_verbose==1){
-                            print_verbose_state(page_num_acc, frames[evict_idx].vpn, 0);
-                        }
-                    }
-                    // simulating bringing the page in from memory ...
-                    if(debug==1) printf("page number %d is at frame no. %d \n", page_num_acc, evict_idx);
-                    frames[evict_idx].vpn = page_num_acc;
-                    frames[evict_idx].frame_number = evict_idx;
-                    frames[evict_idx].brought_in_at = mem_accesses - 1;
-                    frames[evict_idx].use = 1;
-                    frames[evict_idx].valid = 1;
-                    frames[evict_idx].first_write = mem_accesses - 1;
-                    frames[evict_idx].last_write = mem_accesses - 1;
-                    frames[evict_idx].first_read = -1;
-                    frames[evict_idx].last_read = -1;
-                    frames[evict_idx].dirty = 1;
-                    frames[evict_idx].last_used = mem_accesses - 1;
-                }else{
-                    // simulating bringing the page in from memory ...
-                    // set page num to empty idx page frame
-                    assert(empty_frame_idx != -1 && "empty frame index can't be -1");
-                    if(debug==1) printf("page number %d is at frame no. %d \n", page_num_acc, empty_frame_idx);
-                    frames[empty_frame_idx].vpn = page_num_acc;
-                    frames[empty_frame_idx].frame_number = empty_frame_idx;
-                    frames[empty_frame_idx].brought_in_at = mem_accesses - 1;
-                    frames[empty_frame_idx].use = 1;
-                    frames[empty_frame_idx].valid = 1;
-                    frames[empty_frame_idx].first_write = mem_accesses - 1;
-                    frames[empty_frame_idx].last_write = mem_accesses - 1;
-                    frames[empty_frame_idx].first_read = -1;
-                    frames[empty_frame_idx].last_read = -1;
-                    frames[empty_frame_idx].dirty = 1;
-                    frames[empty_frame_idx].last_used = mem_accesses - 1;
-                }
-            }            
+            ts->prev += (zigzag >> 1) ^ -(zigzag & 1);
+            if(ts->record_bytes == 4) ts->prev &= 0xffffffffULL;
+            record = ts->prev;
         }
+        unpack_record(record, line);
+        ts->records++;
+        return 1;
+    }
+    // text, parsed like parse_text_trace
+    do{
+        c = stream_getc(ts);
+    }while(c >= 0 && is_trace_space(c));
+    if(c < 0) return 0;
+    int no_digits = 1;
+    if(c == '0'){
+        c = stream_getc(ts);
+        if(c == 'x' || c == 'X') c = stream_getc(ts);
+        else no_digits = 0;
+    }
+    unsigned long long virt_mem_addr = 0;
+    int overflowed = 0;
+    while(c >= 0 && hex_digit[c] >= 0){
+        if(virt_mem_addr >> 60 != 0) overflowed = 1;
+        virt_mem_addr = (virt_mem_addr << 4) | hex_digit[c];
+        no_digits = 0;
+        c = stream_getc(ts);
     }
-    print_state(mem_accesses, misses, writes_to_disk, drops_non_dirty);
-    // printf("Evictions %d \n", evictions);
-    fclose(file_ptr);
+    while(c >= 0 && is_trace_space(c)) c = stream_getc(ts);
+    if(no_digits || c < 0){
+        printf("Malformed trace line %lld, exiting.. \n", ts->records + 1);
+        exit(1);
+    }
+    check_address(virt_mem_addr, overflowed, ts->records + 1);
+    line->vpn = page_id(virt_mem_addr >> page_frame_size);
+    line->read = (c=='R');
+    ts->records++;
+    return 1;
+}
+
+// whether another record follows, without consuming it; whitespace between text
+// records is skipped, read_stream_record would skip it anyway
+int stream_at_end(struct trace_stream* ts){
+    int c;
+    do{
+        c = stream_getc(ts);
+    }while(c >= 0 && ts->is_binary == 0 && is_trace_space(c));
+    if(c < 0) return 1;
+    // the byte just came out of the buffer, so it can be put back
+    ts->pos--;
     return 0;
-}
\ No newline at end of file
+}
+
+// fills up to max records, fewer only when the input runs out; with peek_end set,
+// finished is set as soon as the input is known to be over, even when the last batch
+// comes out full. That waits for the next record on a pipe, so only OPT asks for it
+int read_stream_batch(struct trace_stream* ts, struct parsed_line* lines, int max, int peek_end){
+    int count = 0;
+    while(count < max && ts->finished == 0){
+        if(read_stream_record(ts, &lines[count]) == 1) count++;
+        else ts->finished = 1;
+    }
+    if(peek_end == 1 && ts->finished == 0 && stream_at_end(ts) == 1) ts->finished = 1;
+    return count;
+}
+
+void write_trace_header(FILE* out, int total_accesses, unsigned flags){
+    unsigned char header[TRACE_HEADER_SIZE];
+    memcpy(header, TRACE_MAGIC, 4);
+    put_u32(header + 4, TRACE_VERSION);
+    put_u32(header + 8, page_frame_size);
+    put_u32(header + 12, flags);
+    put_u64(header + 16, (unsigned long long)total_accesses);
+    fwrite(header, 1, TRACE_HEADER_SIZE, out);
+}
+
+// writes parsed_lines out as a binary trace, see TRACE_MAGIC for the layout
+void convert_trace(char* trace_file_name, char* out_file_name, int use_varint){
+    int total_accesses = load_trace(trace_file_name);
+    FILE* out = fopen(out_file_name, "wb");
+    if(out==NULL){
+        printf("Could not open %s for writing, exiting.. \n", out_file_name);
+        exit(1);
+    }
+    write_trace_header(out, total_accesses, use_varint == 1 ? TRACE_FLAG_VARINT : 0);
+    size_t bytes = TRACE_HEADER_SIZE;
+    unsigned long long prev = 0;
+    for(int j=0; j<total_accesses; j++){
+        unsigned long long record = pack_record(page_number(parsed_lines[j].vpn), parsed_lines[j].read);
+        unsigned char encoded[10];
+        int len = 0;
+        if(use_varint == 1){
+            long long delta = (long long)(record - prev);
+            unsigned long long zigzag = ((unsigned long long)delta << 1) ^ (unsigned long long)(delta >> 63);
+            do{
+                unsigned char byte = zigzag & 0x7f;
+                zigzag >>= 7;
+                encoded[len++] = byte | (zigzag != 0 ? 0x80 : 0);
+            }while(zigzag != 0);
+            prev = record;
+        }else{
+            put_u64(encoded, record);
+            len = 8;
+        }
+        fwrite(encoded, 1, len, out);
+        bytes += len;
+    }
+    if(fclose(out) != 0){
+        printf("Could not write %s, exiting.. \n", out_file_name);
+        exit(1);
+    }
+    printf("Wrote %d accesses (%zu bytes) to %s \n", total_accesses, bytes, out_file_name);
+}
+
+void print_state(int num_mem_access, int misses, int writes, int drops){
+    printf("Number of memory accesses: %d\nNumber of misses: %d\nNumber of writes: %d\nNumber of drops: %d\n",num_mem_access,misses,writes,drops);
+}
+
+// verbose output goes through an event log: the simulation only stores each eviction
+// in a preallocated ring of blocks, and a writer thread turns full blocks into the
+// "Page 0x..." lines (or 20 byte binary records, u64 read page | u64 evicted page |
+// u32 was dirty, little endian) and writes them out in one go
+#define EVENT_LOG_BLOCK 16384
+#define EVENT_LOG_BLOCKS 8
+
+struct eviction_event {
+    int read;
+    int written;
+    int was_dirty;
+};
+
+struct event_log {
+    struct eviction_event* events;
+    int block_length[EVENT_LOG_BLOCKS];
+    // the block the simulation is filling and how far it got
+    int fill_block;
+    int fill_count;
+    // blocks handed to the writer and blocks it has written, the ring is full
+    // when EVENT_LOG_BLOCKS blocks are waiting
+    long long submitted;
+    long long drained;
+    int done;
+    FILE* out;
+    int binary;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+};
+
+// what printf("%05llx") would print
+char* put_hex(char* p, unsigned long long value){
+    char digits[16];
+    int n = 0;
+    do{
+        digits[n++] = "0123456789abcdef"[value & 0xf];
+        value >>= 4;
+    }while(value != 0);
+    for(int pad=n; pad<5; pad++) *p++ = '0';
+    while(n > 0) *p++ = digits[--n];
+    return p;
+}
+
+char* put_text(char* p, const char* text){
+    size_t n = strlen(text);
+    memcpy(p, text, n);
+    return p + n;
+}
+
+// formats one event exactly like the old synchronous print_verbose_state did
+char* format_verbose_state(char* p, struct eviction_event* ev){
+    p = put_text(p, "Page 0x");
+    p = put_hex(p, page_number(ev->read));
+    p = put_text(p, " was read from disk, page 0x");
+    p = put_hex(p, page_number(ev->written));
+    if(ev->was_dirty==1){
+        p = put_text(p, " was written to the disk. \n");
+    }else{
+        p = put_text(p, " was dropped (it was not dirty). \n");
+    }
+    return p;
+}
+
+void* event_log_writer(void* arg){
+    struct event_log* log = (struct event_log*)arg;
+    // a formatted line is at most 120 bytes
+    char* text = (char*)malloc(EVENT_LOG_BLOCK * 120);
+    while(1){
+        pthread_mutex_lock(&log->lock);
+        while(log->drained == log->submitted && log->done == 0){
+            pthread_cond_wait(&log->changed, &log->lock);
+        }
+        if(log->drained == log->submitted){
+            pthread_mutex_unlock(&log->lock);
+            break;
+        }
+        int block = log->drained % EVENT_LOG_BLOCKS;
+        int length = log->block_length[block];
+        pthread_mutex_unlock(&log->lock);
+        struct eviction_event* events = log->events + (size_t)block * EVENT_LOG_BLOCK;
+        char* p = text;
+        for(int e=0; e<length; e++){
+            if(log->binary == 1){
+                unsigned long long read = page_number(events[e].read);
+                unsigned long long written = page_number(events[e].written);
+                put_u32((unsigned char*)p, (unsigned)read);
+                put_u32((unsigned char*)p + 4, (unsigned)(read >> 32));
+                put_u32((unsigned char*)p + 8, (unsigned)written);
+                put_u32((unsigned char*)p + 12, (unsigned)(written >> 32));
+                put_u32((unsigned char*)p + 16, events[e].was_dirty);
+                p += 20;
+            }else{
+                p = format_verbose_state(p, &events[e]);
+            }
+        }
+        fwrite(text, 1, p - text, log->out);
+        pthread_mutex_lock(&log->lock);
+        log->drained++;
+        pthread_cond_broadcast(&log->changed);
+        pthread_mutex_unlock(&log->lock);
+    }
+    free(text);
+    return NULL;
+}
+
+struct event_log* open_event_log(FILE* out, int binary){
+    struct event_log* log = (struct event_log*)calloc(1, sizeof(struct event_log));
+    log->events = (struct eviction_event*)malloc((size_t)EVENT_LOG_BLOCKS * EVENT_LOG_BLOCK * sizeof(struct eviction_event));
+    log->out = out;
+    log->binary = binary;
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_cond_init(&log->changed, NULL);
+    if(pthread_create(&log->writer, NULL, event_log_writer, log) != 0){
+        printf("Could not start the event log writer, exiting.. \n");
+        exit(1);
+    }
+    return log;
+}
+
+// hands the block being filled to the writer, waiting for room in the ring
+void submit_event_block(struct event_log* log){
+    pthread_mutex_lock(&log->lock);
+    log->block_length[log->fill_block] = log->fill_count;
+    log->submitted++;
+    pthread_cond_broadcast(&log->changed);
+    while(log->submitted - log->drained >= EVENT_LOG_BLOCKS){
+        pthread_cond_wait(&log->changed, &log->lock);
+    }
+    pthread_mutex_unlock(&log->lock);
+    log->fill_block = log->submitted % EVENT_LOG_BLOCKS;
+    log->fill_count = 0;
+}
+
+static inline void log_eviction(struct event_log* log, int read, int written, int was_dirty){
+    struct eviction_event* ev = &log->events[(size_t)log->fill_block * EVENT_LOG_BLOCK + log->fill_count];
+    ev->read = read;
+    ev->written = written;
+    ev->was_dirty = was_dirty;
+    log->fill_count++;
+    if(log->fill_count == EVENT_LOG_BLOCK) submit_event_block(log);
+}
+
+// returns once everything logged so far is written, so other output can follow it
+void flush_event_log(struct event_log* log){
+    if(log->fill_count > 0) submit_event_block(log);
+    pthread_mutex_lock(&log->lock);
+    while(log->drained != log->submitted){
+        pthread_cond_wait(&log->changed, &log->lock);
+    }
+    pthread_mutex_unlock(&log->lock);
+    fflush(log->out);
+}
+
+void close_event_log(struct event_log* log){
+    flush_event_log(log);
+    pthread_mutex_lock(&log->lock);
+    log->done = 1;
+    pthread_cond_broadcast(&log->changed);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->writer, NULL);
+    pthread_mutex_destroy(&log->lock);
+    pthread_cond_destroy(&log->changed);
+    free(log->events);
+    free(log);
+}
+
+// Fenwick tree over access times, holding a 1 at the last access of every page
+// so the number of distinct pages touched in a time window is a range sum
+void fenwick_add(int* tree, int size, int i, int value){
+    for(i++; i<=size; i += i & (-i)){
+        tree[i] += value;
+    }
+}
+
+// sum of positions 0..i, 0 for i < 0
+int fenwick_sum(int* tree, int i){
+    int sum = 0;
+    for(i++; i>0; i -= i & (-i)){
+        sum += tree[i];
+    }
+    return sum;
+}
+
+int stats_bucket(int value){
+    int b = 0;
+    while(value > 1 && b < STATS_BUCKETS - 1){
+        value >>= 1;
+        b++;
+    }
+    return b;
+}
+
+void init_stats(struct sim_stats* stats, int total_accesses, int window){
+    memset(stats, 0, sizeof(struct sim_stats));
+    stats->reuse_last = (int*)malloc((1 << page_num_size) * sizeof(int));
+    for(int v=0; v<(1 << page_num_size); v++){
+        stats->reuse_last[v] = -1;
+    }
+    stats->reuse_tree_size = total_accesses;
+    stats->reuse_tree = (int*)calloc(total_accesses + 1, sizeof(int));
+    stats->window = window;
+    stats->num_windows = (total_accesses + window - 1) / window;
+    stats->window_misses = (int*)calloc(stats->num_windows + 1, sizeof(int));
+}
+
+void free_stats(struct sim_stats* stats){
+    free(stats->reuse_last);
+    free(stats->reuse_tree);
+    free(stats->window_misses);
+}
+
+// called for every access, before the simulator looks the page up
+void stats_access(struct sim_stats* stats, int vpn, int access_idx){
+    int prev = stats->reuse_last[vpn];
+    if(prev == -1){
+        stats->first_touches++;
+    }else{
+        int distance = fenwick_sum(stats->reuse_tree, access_idx - 1) - fenwick_sum(stats->reuse_tree, prev) + 1;
+        stats->reuse_hist[stats_bucket(distance)]++;
+        fenwick_add(stats->reuse_tree, stats->reuse_tree_size, prev, -1);
+    }
+    fenwick_add(stats->reuse_tree, stats->reuse_tree_size, access_idx, 1);
+    stats->reuse_last[vpn] = access_idx;
+}
+
+void stats_hit(struct sim_stats* stats, int is_read){
+    if(is_read == 1) stats->read_hits++;
+    else stats->write_hits++;
+}
+
+void stats_miss(struct sim_stats* stats, int is_read, int access_idx){
+    if(is_read == 1) stats->read_misses++;
+    else stats->write_misses++;
+    stats->window_misses[access_idx / stats->window]++;
+}
+
+void stats_clock_sweep(struct sim_stats* stats, int scanned){
+    stats->clock_sweeps++;
+    stats->clock_scanned += scanned;
+    if(scanned > stats->clock_max_sweep) stats->clock_max_sweep = scanned;
+    stats->clock_sweep_hist[stats_bucket(scanned)]++;
+}
+
+// histogram as a json array, trailing empty buckets left out
+void print_stats_histogram(FILE* out, long long* hist){
+    int used = STATS_BUCKETS;
+    while(used > 0 && hist[used - 1] == 0) used--;
+    fprintf(out, "[");
+    for(int b=0; b<used; b++){
+        fprintf(out, "%s%lld", b == 0 ? "" : ", ", hist[b]);
+    }
+    fprintf(out, "]");
+}
+
+void print_stats_json(FILE* out, struct simulation* sim, int total_accesses){
+    struct sim_stats* stats = sim->stats;
+    fprintf(out, "{\n");
+    fprintf(out, "  \"strategy\": \"%s\",\n", sim->policy->name);
+    fprintf(out, "  \"frames\": %d,\n", sim->num_frames);
+    fprintf(out, "  \"accesses\": %d,\n", sim->mem_accesses);
+    fprintf(out, "  \"misses\": %d,\n", sim->misses);
+    fprintf(out, "  \"writes_to_disk\": %d,\n", sim->writes_to_disk);
+    fprintf(out, "  \"drops_non_dirty\": %d,\n", sim->drops_non_dirty);
+    fprintf(out, "  \"read_hits\": %lld,\n", stats->read_hits);
+    fprintf(out, "  \"read_misses\": %lld,\n", stats->read_misses);
+    fprintf(out, "  \"write_hits\": %lld,\n", stats->write_hits);
+    fprintf(out, "  \"write_misses\": %lld,\n", stats->write_misses);
+    if(strcmp(sim->policy->name, "CLOCK")==0){
+        fprintf(out, "  \"clock_sweep\": {\"evictions\": %lld, \"frames_scanned\": %lld, \"max\": %d, \"histogram\": ",
+            stats->clock_sweeps, stats->clock_scanned, stats->clock_max_sweep);
+        print_stats_histogram(out, stats->clock_sweep_hist);
+        fprintf(out, "},\n");
+    }
+    fprintf(out, "  \"reuse_distance\": {\"first_touches\": %lld, \"histogram\": ", stats->first_touches);
+    print_stats_histogram(out, stats->reuse_hist);
+    fprintf(out, "},\n");
+    fprintf(out, "  \"window\": %d,\n", stats->window);
+    fprintf(out, "  \"window_miss_rate\": [");
+    for(int w=0; w<stats->num_windows; w++){
+        int length = w == stats->num_windows - 1 ? total_accesses - w * stats->window : stats->window;
+        fprintf(out, "%s%.6f", w == 0 ? "" : ", ", (double)stats->window_misses[w] / length);
+    }
+    fprintf(out, "]\n");
+    fprintf(out, "}\n");
+}
+
+void build_next_use(int total_accesses){
+    // one backward pass over the trace, remembering where each page is accessed next
+    int *seen_at = (int*)malloc((1 << page_num_size) * sizeof(int));
+    for(int v=0; v<(1 << page_num_size); v++){
+        seen_at[v] = total_accesses;
+    }
+    next_use = (int*)malloc(total_accesses * sizeof(int));
+    for(int j=total_accesses-1; j>=0; j--){
+        next_use[j] = seen_at[parsed_lines[j].vpn];
+        seen_at[parsed_lines[j].vpn] = j;
+    }
+    free(seen_at);
+}
+
+// frame a should be evicted before frame b: it is used further in the future,
+// or neither is used again and a is the smaller frame no
+int opt_heap_before(struct simulation* sim, int a, int b){
+    if(sim->opt_key[a] != sim->opt_key[b]) return sim->opt_key[a] > sim->opt_key[b];
+    return a < b;
+}
+
+void opt_heap_swap(struct simulation* sim, int i, int j){
+    int *opt_heap = sim->opt_heap;
+    int tmp = opt_heap[i];
+    opt_heap[i] = opt_heap[j];
+    opt_heap[j] = tmp;
+    sim->opt_heap_pos[opt_heap[i]] = i;
+    sim->opt_heap_pos[opt_heap[j]] = j;
+}
+
+void init_opt(struct simulation* sim){
+    int num_frames = sim->num_frames;
+    sim->opt_heap = (int*)malloc(num_frames * sizeof(int));
+    sim->opt_heap_pos = (int*)malloc(num_frames * sizeof(int));
+    sim->opt_key = (int*)malloc(num_frames * sizeof(int));
+    // all keys equal, so frame order is already a valid heap
+    for(int i=0; i<num_frames; i++){
+        sim->opt_heap[i] = i;
+        sim->opt_heap_pos[i] = i;
+        sim->opt_key[i] = -1;
+    }
+}
+
+void opt_sift_down(struct simulation* sim, int pos){
+    int num_frames = sim->num_frames;
+    int *opt_heap = sim->opt_heap;
+    while(1){
+        int best = pos;
+        int l = 2 * pos + 1;
+        int r = 2 * pos + 2;
+        if(l < num_frames && opt_heap_before(sim, opt_heap[l], opt_heap[best])) best = l;
+        if(r < num_frames && opt_heap_before(sim, opt_heap[r], opt_heap[best])) best = r;
+        if(best == pos) break;
+        opt_heap_swap(sim, pos, best);
+        pos = best;
+    }
+}
+
+// page in frame_idx was accessed at access_idx, re-key it by its next use
+void opt_touch(struct simulation* sim, int frame_idx, int vpn, int access_idx){
+    int *opt_heap = sim->opt_heap;
+    sim->opt_key[frame_idx] = next_use[access_idx];
+    int pos = sim->opt_heap_pos[frame_idx];
+    // sift up
+    while(pos > 0 && opt_heap_before(sim, opt_heap[pos], opt_heap[(pos - 1) / 2])){
+        opt_heap_swap(sim, pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+    opt_sift_down(sim, pos);
+}
+
+// the parsed_lines window moved on, keys are positions in it now: every resident
+// page is keyed by its first access in the window, or by window_length if it has none
+void opt_rekey(struct simulation* sim, int window_length){
+    for(int i=0; i<sim->num_frames; i++){
+        if(sim->frame_vpn[i] != -1) sim->opt_key[i] = window_length;
+    }
+    for(int j=window_length-1; j>=0; j--){
+        int i = sim->page_table[parsed_lines[j].vpn];
+        if(i != -1) sim->opt_key[i] = j;
+    }
+    for(int pos=sim->num_frames/2-1; pos>=0; pos--){
+        opt_sift_down(sim, pos);
+    }
+}
+
+int execute_opt(struct simulation* sim, int vpn, int access_idx){
+    if(debug==1) printf("Performing OPT.... \n");
+    // the heap top is the page accessed furthest in the future; pages that are
+    // never accessed again share the largest key and are ordered by frame no,
+    // so in such cases the smallest frame no is evicted
+    assert(sim->opt_key[sim->opt_heap[0]] != -1 && "all frames must be filled before OPT evicts");
+    int *opt_heap = sim->opt_heap;
+    int horizon = sim->opt_horizon;
+    if(horizon != 0 && sim->opt_key[opt_heap[0]] == horizon && sim->num_frames > 1){
+        if(sim->opt_key[opt_heap[1]] == horizon || (sim->num_frames > 2 && sim->opt_key[opt_heap[2]] == horizon)){
+            sim->opt_blind_evictions++;
+        }
+    }
+    return opt_heap[0];
+// The optimal replacement policy
+// leads to the fewest number of misses overall. 
+// Belady showed that a simple (but, unfortunately, difficult to implement!) 
+// approach that replaces the page that will be 
+// accessed furthest in the future is the optimal policy,
+// resulting in the fewest-possible cache misses.
+}
+
+void fifo_push(struct simulation* sim, int frame_idx, int vpn, int access_idx){
+    int num_frames = sim->num_frames;
+    assert(sim->fifo_count < num_frames && "fifo queue can't hold more frames than there are");
+    sim->fifo_queue[(sim->fifo_head + sim->fifo_count) % num_frames] = frame_idx;
+    sim->fifo_count++;
+}
+
+void init_fifo(struct simulation* sim){
+    sim->fifo_queue = (int*)malloc(sim->num_frames * sizeof(int));
+}
+
+int execute_fifo(struct simulation* sim, int vpn, int access_idx){
+    int num_frames = sim->num_frames;
+    if(debug==1) printf("Performing FIFO.... \n");
+    // FIFO (first-in, first-out) replacement, where pages
+    // were simply placed in a queue when they enter the system; when a replacement occurs, the page on the tail of the queue (the “first-in” page) is
+    // evicted. FIFO has one great strength: it is quite simple to implement.
+    assert(sim->fifo_count == num_frames && "all frames must be in the queue when FIFO evicts");
+    int evict_idx = sim->fifo_queue[sim->fifo_head];
+    assert(sim->frame_vpn[evict_idx] != -1 && "frame at the head of the queue must hold a page");
+    // the frame is refilled right away and pushed back at the tail by the caller
+    sim->fifo_head = (sim->fifo_head + 1) % num_frames;
+    sim->fifo_count--;
+    return evict_idx;
+}
+
+// where to begin?
+// how to update begin after evict inde return?
+// piazza doubt?
+int execute_clock(struct simulation* sim, int vpn, int access_idx){
+// How does the OS employ the use bit to approximate LRU? Well, there
+// could be a lot of ways, but with the clock algorithm, one simple
+// approach was suggested. Imagine all the pages of the system arranged in
+// a circular list. A clock hand points to some particular page to begin with
+// (it doesn’t really matter which). When a replacement must occur, the OS
+// checks if the currently-pointed to page P has a use bit of 1 or 0. If 1, this
+// implies that page P was recently used and thus is not a good candidate
+// for replacement. Thus, the use bit for P is set to 0 (cleared), and the clock
+// hand is incremented to the next page (P + 1). The algorithm continues
+// until it finds a use bit that is set to 0, implying this page has not been
+// recently used (or, in the worst case, that all pages have been and that we
+// have now searched through the entire set of pages, clearing all the bits).
+    if(debug==1) printf("Performing CLOCK.... \n");
+    int num_frames = sim->num_frames;
+    char *frame_use = sim->frame_use;
+    int clock_pointer = sim->clock_pointer;
+    int start_pointer = clock_pointer;
+    int evict_idx_temp = -1;
+    // frames the hand passes over, only kept for -stats
+    int scanned = 1;
+    if(frame_use[clock_pointer] == 1) {
+            frame_use[clock_pointer] = 0;
+            clock_pointer = (clock_pointer + 1) % num_frames;
+            scanned++;
+    }
+    while(start_pointer != clock_pointer){
+        if(frame_use[clock_pointer] == 1) {
+            frame_use[clock_pointer] = 0;
+            clock_pointer = (clock_pointer + 1) % num_frames;
+            scanned++;
+            continue;
+        }
+        evict_idx_temp = clock_pointer;
+        clock_pointer = (clock_pointer + 1) % num_frames;
+        sim->clock_pointer = clock_pointer;
+        if(sim->stats != NULL) stats_clock_sweep(sim->stats, scanned);
+        return evict_idx_temp % num_frames;
+    } 
+    evict_idx_temp = clock_pointer;
+    clock_pointer = (clock_pointer + 1) % num_frames;
+    sim->clock_pointer = clock_pointer;
+    if(sim->stats != NULL) stats_clock_sweep(sim->stats, scanned);
+    return (evict_idx_temp)%num_frames;
+}
+
+void init_lru(struct simulation* sim){
+    sim->lru_prev = (int*)malloc(sim->num_frames * sizeof(int));
+    sim->lru_next = (int*)malloc(sim->num_frames * sizeof(int));
+    for(int i=0; i<sim->num_frames; i++){
+        sim->lru_prev[i] = -1;
+        sim->lru_next[i] = -1;
+    }
+}
+
+// page in frame_idx was just accessed, move it to the most recently used end
+void lru_touch(struct simulation* sim, int frame_idx, int vpn, int access_idx){
+    int *lru_prev = sim->lru_prev;
+    int *lru_next = sim->lru_next;
+    if(sim->lru_tail == frame_idx) return;
+    if(sim->lru_head == frame_idx || lru_prev[frame_idx] != -1){
+        // unlink from its current position
+        if(lru_prev[frame_idx] != -1){
+            lru_next[lru_prev[frame_idx]] = lru_next[frame_idx];
+        }else{
+            sim->lru_head = lru_next[frame_idx];
+        }
+        lru_prev[lru_next[frame_idx]] = lru_prev[frame_idx];
+    }
+    lru_prev[frame_idx] = sim->lru_tail;
+    lru_next[frame_idx] = -1;
+    if(sim->lru_tail != -1){
+        lru_next[sim->lru_tail] = frame_idx;
+    }else{
+        sim->lru_head = frame_idx;
+    }
+    sim->lru_tail = frame_idx;
+}
+
+int execute_lru(struct simulation* sim, int vpn, int access_idx){
+    //  printf("Performing LRU.... \n");
+    //  Similarly, the Least-Recently Used (LRU) policy replaces the least-recently-used page.
+    int evict_idx = sim->lru_head;
+    assert(evict_idx != -1 && sim->frame_vpn[evict_idx] != -1 && "least recently used frame must hold a page");
+    // the caller refills the frame and touches it, moving it to the tail
+    return evict_idx;
+}
+
+int execute_random(struct simulation* sim, int vpn, int access_idx){
+    // printf("Performing RANDOM.... \n");
+    // simply picks a random page to replace under memory pressure
+    int32_t r;
+    random_r(&sim->rng, &r);
+    int idx = r % sim->num_frames;
+    return idx;
+}
+
+void dlist_init(struct dlist* l){
+    l->head = -1;
+    l->tail = -1;
+    l->size = 0;
+}
+
+void dlist_push_tail(struct dlist* l, int* prev, int* next, int x){
+    prev[x] = l->tail;
+    next[x] = -1;
+    if(l->tail != -1){
+        next[l->tail] = x;
+    }else{
+        l->head = x;
+    }
+    l->tail = x;
+    l->size++;
+}
+
+void dlist_remove(struct dlist* l, int* prev, int* next, int x){
+    if(prev[x] != -1){
+        next[prev[x]] = next[x];
+    }else{
+        l->head = next[x];
+    }
+    if(next[x] != -1){
+        prev[next[x]] = prev[x];
+    }else{
+        l->tail = prev[x];
+    }
+    prev[x] = -1;
+    next[x] = -1;
+    l->size--;
+}
+
+int dlist_pop_head(struct dlist* l, int* prev, int* next){
+    int x = l->head;
+    assert(x != -1 && "can't pop from an empty list");
+    dlist_remove(l, prev, next, x);
+    return x;
+}
+
+// list links shared by ARC, 2Q and CLOCK-Pro
+void init_adaptive(struct simulation* sim){
+    int num_frames = sim->num_frames;
+    int num_pages = 1 << page_num_size;
+    sim->frame_prev = (int*)malloc(num_frames * sizeof(int));
+    sim->frame_next = (int*)malloc(num_frames * sizeof(int));
+    sim->frame_list = (int*)calloc(num_frames, sizeof(int));
+    sim->page_prev = (int*)malloc(num_pages * sizeof(int));
+    sim->page_next = (int*)malloc(num_pages * sizeof(int));
+    sim->page_list = (int*)calloc(num_pages, sizeof(int));
+    for(int i=0; i<num_frames; i++){
+        sim->frame_prev[i] = -1;
+        sim->frame_next[i] = -1;
+    }
+    for(int v=0; v<num_pages; v++){
+        sim->page_prev[v] = -1;
+        sim->page_next[v] = -1;
+    }
+    dlist_init(&sim->arc_t1);
+    dlist_init(&sim->arc_t2);
+    dlist_init(&sim->arc_b1);
+    dlist_init(&sim->arc_b2);
+    dlist_init(&sim->twoq_a1in);
+    dlist_init(&sim->twoq_am);
+    dlist_init(&sim->twoq_a1out);
+}
+
+// ARC (Megiddo and Modha) splits memory between T1, pages seen once recently, and
+// T2, pages seen at least twice. B1 and B2 remember the pages recently evicted from
+// each, and a hit in one of those ghost lists moves the target size p of T1 towards
+// the list that would have kept the page.
+#define ARC_T1 1
+#define ARC_T2 2
+#define ARC_B1 1
+#define ARC_B2 2
+
+// evicts the oldest page of T1 or T2 depending on p, remembering it in B1 or B2
+int arc_replace(struct simulation* sim, int in_b2){
+    int victim;
+    if(sim->arc_t1.size >= 1 && ((in_b2 == 1 && sim->arc_t1.size == sim->arc_p) || sim->arc_t1.size > sim->arc_p)){
+        victim = dlist_pop_head(&sim->arc_t1, sim->frame_prev, sim->frame_next);
+        dlist_push_tail(&sim->arc_b1, sim->page_prev, sim->page_next, sim->frame_vpn[victim]);
+        sim->page_list[sim->frame_vpn[victim]] = ARC_B1;
+    }else{
+        victim = dlist_pop_head(&sim->arc_t2, sim->frame_prev, sim->frame_next);
+        dlist_push_tail(&sim->arc_b2, sim->page_prev, sim->page_next, sim->frame_vpn[victim]);
+        sim->page_list[sim->frame_vpn[victim]] = ARC_B2;
+    }
+    sim->frame_list[victim] = 0;
+    return victim;
+}
+
+void arc_drop_ghost(struct simulation* sim, struct dlist* l){
+    int vpn = dlist_pop_head(l, sim->page_prev, sim->page_next);
+    sim->page_list[vpn] = 0;
+}
+
+// memory is full and page vpn missed, adapt p and pick the frame to give up
+int execute_arc(struct simulation* sim, int vpn, int access_idx){
+    if(debug==1) printf("Performing ARC.... \n");
+    int c = sim->num_frames;
+    int evict_idx = -1;
+    if(sim->page_list[vpn] == ARC_B1){
+        int delta = sim->arc_b1.size >= sim->arc_b2.size ? 1 : sim->arc_b2.size / sim->arc_b1.size;
+        sim->arc_p = sim->arc_p + delta < c ? sim->arc_p + delta : c;
+        evict_idx = arc_replace(sim, 0);
+    }else if(sim->page_list[vpn] == ARC_B2){
+        int delta = sim->arc_b2.size >= sim->arc_b1.size ? 1 : sim->arc_b1.size / sim->arc_b2.size;
+        sim->arc_p = sim->arc_p - delta > 0 ? sim->arc_p - delta : 0;
+        evict_idx = arc_replace(sim, 1);
+    }else if(sim->arc_t1.size + sim->arc_b1.size == c){
+        if(sim->arc_t1.size < c){
+            arc_drop_ghost(sim, &sim->arc_b1);
+            evict_idx = arc_replace(sim, 0);
+        }else{
+            // T1 holds everything, its oldest page goes without leaving a ghost
+            evict_idx = dlist_pop_head(&sim->arc_t1, sim->frame_prev, sim->frame_next);
+            sim->frame_list[evict_idx] = 0;
+        }
+    }else{
+        if(sim->arc_t1.size + sim->arc_t2.size + sim->arc_b1.size + sim->arc_b2.size == 2 * c){
+            arc_drop_ghost(sim, &sim->arc_b2);
+        }
+        evict_idx = arc_replace(sim, 0);
+    }
+    return evict_idx;
+}
+
+// page vpn was brought into frame_idx, a page remembered by a ghost list goes to T2
+void arc_insert(struct simulation* sim, int frame_idx, int vpn, int access_idx){
+    if(sim->page_list[vpn] != 0){
+        dlist_remove(sim->page_list[vpn] == ARC_B1 ? &sim->arc_b1 : &sim->arc_b2, sim->page_prev, sim->page_next, vpn);
+        sim->page_list[vpn] = 0;
+        dlist_push_tail(&sim->arc_t2, sim->frame_prev, sim->frame_next, frame_idx);
+        sim->frame_list[frame_idx] = ARC_T2;
+    }else{
+        dlist_push_tail(&sim->arc_t1, sim->frame_prev, sim->frame_next, frame_idx);
+        sim->frame_list[frame_idx] = ARC_T1;
+    }
+}
+
+void arc_hit(struct simulation* sim, int frame_idx, int vpn, int access_idx){
+    struct dlist* from = sim->frame_list[frame_idx] == ARC_T1 ? &sim->arc_t1 : &sim->arc_t2;
+    dlist_remove(from, sim->frame_prev, sim->frame_next, frame_idx);
+    dlist_push_tail(&sim->arc_t2, sim->frame_prev, sim->frame_next, frame_idx);
+    sim->frame_list[frame_idx] = ARC_T2;
+}
+
+// 2Q (Johnson and Shasha), full version: new pages enter the FIFO A1in and only
+// pages re-referenced after leaving it, while still remembered by the ghost FIFO
+// A1out, are promoted to the LRU list Am. A1in gets a quarter of memory and
+// A1out remembers half of memory's worth of pages.
+#define TWOQ_A1IN 1
+#define TWOQ_AM 2
+#define TWOQ_A1OUT 1
+
+int execute_2q(struct simulation* sim, int vpn, int access_idx){
+    if(debug==1) printf("Performing 2Q.... \n");
+    int k_in = sim->num_frames / 4 > 0 ? sim->num_frames / 4 : 1;
+    int evict_idx;
+    if(sim->twoq_a1in.size > k_in || sim->twoq_am.size == 0){
+        // A1out is trimmed in twoq_insert, once it is known whether the faulting page was in it
+        evict_idx = dlist_pop_head(&sim->twoq_a1in, sim->frame_prev, sim->frame_next);
+        int evicted = sim->frame_vpn[evict_idx];
+        dlist_push_tail(&sim->twoq_a1out, sim->page_prev, sim->page_next, evicted);
+        sim->page_list[evicted] = TWOQ_A1OUT;
+    }else{
+        evict_idx = dlist_pop_head(&sim->twoq_am, sim->frame_prev, sim->frame_next);
+    }
+    sim->frame_list[evict_idx] = 0;
+    return evict_idx;
+}
+
+void twoq_insert(struct simulation* sim, int frame_idx, int vpn, int access_idx){
+    if(sim->page_list[vpn] == TWOQ_A1OUT){
+        dlist_remove(&sim->twoq_a1out, sim->page_prev, sim->page_next, vpn);
+        sim->page_list[vpn] = 0;
+        dlist_push_tail(&sim->twoq_am, sim->frame_prev, sim->frame_next, frame_idx);
+        sim->frame_list[frame_idx] = TWOQ_AM;
+    }else{
+        dlist_push_tail(&sim->twoq_a1in, sim->frame_prev, sim->frame_next, frame_idx);
+        sim->frame_list[frame_idx] = TWOQ_A1IN;
+    }
+    int k_out = sim->num_frames / 2 > 0 ? sim->num_frames / 2 : 1;
+    if(sim->twoq_a1out.size > k_out){
+        int forgotten = dlist_pop_head(&sim->twoq_a1out, sim->page_prev, sim->page_next);
+        sim->page_list[forgotten] = 0;
+    }
+}
+
+// a hit in A1in is left alone, that is what makes 2Q scan resistant
+void twoq_hit(struct simulation* sim, int frame_idx, int vpn, int access_idx){
+    if(sim->frame_list[frame_idx] == TWOQ_AM){
+        dlist_remove(&sim->twoq_am, sim->frame_prev, sim->frame_next, frame_idx);
+        dlist_push_tail(&sim->twoq_am, sim->frame_prev, sim->frame_next, frame_idx);
+    }
+}
+
+// CLOCK-Pro (Jiang, Chen and Zhang) keeps hot pages, resident cold pages and
+// non-resident cold pages that are still in their test period on one clock.
+// HAND_cold evicts cold pages, promoting those re-referenced during their test
+// period, HAND_hot demotes hot pages once there are more than num_frames - mc of
+// them, and HAND_test expires test periods so at most num_frames non-resident
+// pages are remembered. mc, the memory given to cold pages, grows when a
+// non-resident page is re-referenced and shrinks when a test period expires.
+// New and promoted pages go to the list head, just behind HAND_hot.
+// HAND_cold sweeps past every hot and non-resident page on its way, which makes
+// an eviction cost up to a whole turn of the clock when mc is small.
+// CLOCKPRO-FIFO approximates HAND_cold with a FIFO of resident cold pages instead:
+// new and demoted cold pages join the tail and a cold page given another test
+// period goes back to it, whereas on the clock a demoted page stays where HAND_hot
+// found it. Its evictions can differ slightly from CLOCKPRO's, but an eviction
+// only ever looks at cold pages.
+#define CLOCKPRO_COLD 1
+#define CLOCKPRO_HOT 2
+#define CLOCKPRO_NONRESIDENT 3
+
+void init_clockpro(struct simulation* sim){
+    init_adaptive(sim);
+    sim->cp_hand_hot = -1;
+    sim->cp_hand_cold = -1;
+    dlist_init(&sim->cp_cold);
+    sim->cp_hand_test = -1;
+    sim->cp_cold_target = sim->num_frames / 2 > 0 ? sim->num_frames / 2 : 1;
+    sim->cp_ref = (char*)calloc(1 << page_num_size, sizeof(char));
+    sim->cp_test = (char*)calloc(1 << page_num_size, sizeof(char));
+}
+
+void init_clockpro_fifo(struct simulation* sim){
+    init_clockpro(sim);
+    sim->cp_fifo_cold = 1;
+}
+
+void clockpro_unlink(struct simulation* sim, int vpn){
+    int next = sim->page_next[vpn];
+    if(next == vpn) next = -1;
+    if(sim->cp_hand_hot == vpn) sim->cp_hand_hot = next;
+    if(sim->cp_hand_cold == vpn) sim->cp_hand_cold = next;
+    if(sim->cp_hand_test == vpn) sim->cp_hand_test = next;
+    if(next != -1){
+        sim->page_next[sim->page_prev[vpn]] = sim->page_next[vpn];
+        sim->page_prev[sim->page_next[vpn]] = sim->page_prev[vpn];
+    }
+    sim->page_prev[vpn] = -1;
+    sim->page_next[vpn] = -1;
+}
+
+void clockpro_insert_at_head(struct simulation* sim, int vpn){
+    int head = sim->cp_hand_hot;
+    if(head == -1){
+        sim->page_prev[vpn] = vpn;
+        sim->page_next[vpn] = vpn;
+        sim->cp_hand_hot = vpn;
+        sim->cp_hand_cold = vpn;
+        sim->cp_hand_test = vpn;
+        return;
+    }
+    sim->page_next[vpn] = head;
+    sim->page_prev[vpn] = sim->page_prev[head];
+    sim->page_next[sim->page_prev[head]] = vpn;
+    sim->page_prev[head] = vpn;
+}
+
+void clockpro_move_to_head(struct simulation* sim, int vpn){
+    clockpro_unlink(sim, vpn);
+    clockpro_insert_at_head(sim, vpn);
+}
+
+// a non-resident page that wasn't re-referenced in its test period is forgotten
+void clockpro_forget(struct simulation* sim, int vpn){
+    clockpro_unlink(sim, vpn);
+    sim->page_list[vpn] = 0;
+    sim->cp_nonresident--;
+    if(sim->cp_cold_target > 1) sim->cp_cold_target--;
+}
+
+void clockpro_run_hand_test(struct simulation* sim){
+    while(sim->cp_nonresident > sim->num_frames){
+        int vpn = sim->cp_hand_test;
+        sim->cp_hand_test = sim->page_next[vpn];
+        if(sim->page_list[vpn] == CLOCKPRO_NONRESIDENT){
+            clockpro_forget(sim, vpn);
+        }else if(sim->page_list[vpn] == CLOCKPRO_COLD){
+            sim->cp_test[vpn] = 0;
+        }
+    }
+}
+
+void clockpro_run_hand_hot(struct simulation* sim){
+    while(sim->cp_hot > sim->num_frames - sim->cp_cold_target){
+        int vpn = sim->cp_hand_hot;
+        sim->cp_hand_hot = sim->page_next[vpn];
+        if(sim->page_list[vpn] == CLOCKPRO_HOT){
+            if(sim->cp_ref[vpn] == 1){
+                sim->cp_ref[vpn] = 0;
+            }else{
+                sim->page_list[vpn] = CLOCKPRO_COLD;
+                sim->cp_test[vpn] = 0;
+                sim->cp_hot--;
+                if(sim->cp_fifo_cold == 1) dlist_push_tail(&sim->cp_cold, sim->frame_prev, sim->frame_next, sim->page_table[vpn]);
+            }
+        }else if(sim->page_list[vpn] == CLOCKPRO_NONRESIDENT){
+            clockpro_forget(sim, vpn);
+        }else{
+            sim->cp_test[vpn] = 0;
+        }
+    }
+}
+
+int execute_clockpro(struct simulation* sim, int vpn, int access_idx){
+    if(debug==1) printf("Performing CLOCK-Pro.... \n");
+    while(1){
+        int cold = sim->cp_hand_cold;
+        sim->cp_hand_cold = sim->page_next[cold];
+        if(sim->page_list[cold] != CLOCKPRO_COLD) continue;
+        if(sim->cp_ref[cold] == 1){
+            sim->cp_ref[cold] = 0;
+            if(sim->cp_test[cold] == 1){
+                // re-referenced during its test period, the page turns hot
+                sim->cp_test[cold] = 0;
+                sim->page_list[cold] = CLOCKPRO_HOT;
+                sim->cp_hot++;
+                clockpro_move_to_head(sim, cold);
+                clockpro_run_hand_hot(sim);
+            }else{
+                sim->cp_test[cold] = 1;
+                clockpro_move_to_head(sim, cold);
+            }
+            continue;
+        }
+        int evict_idx = sim->page_table[cold];
+        if(sim->cp_test[cold] == 1){
+            // stays on the clock without its frame until the test period ends
+            sim->page_list[cold] = CLOCKPRO_NONRESIDENT;
+            sim->cp_nonresident++;
+            clockpro_run_hand_test(sim);
+        }else{
+            clockpro_unlink(sim, cold);
+            sim->page_list[cold] = 0;
+        }
+        return evict_idx;
+    }
+}
+
+// the same decisions with HAND_cold replaced by the cold FIFO
+int execute_clockpro_fifo(struct simulation* sim, int vpn, int access_idx){
+    if(debug==1) printf("Performing CLOCK-Pro with a cold FIFO.... \n");
+    while(1){
+        int evict_idx = dlist_pop_head(&sim->cp_cold, sim->frame_prev, sim->frame_next);
+        int cold = sim->frame_vpn[evict_idx];
+        if(sim->cp_ref[cold] == 1){
+            sim->cp_ref[cold] = 0;
+            if(sim->cp_test[cold] == 1){
+                // re-referenced during its test period, the page turns hot
+                sim->cp_test[cold] = 0;
+                sim->page_list[cold] = CLOCKPRO_HOT;
+                sim->cp_hot++;
+                clockpro_move_to_head(sim, cold);
+                clockpro_run_hand_hot(sim);
+            }else{
+                sim->cp_test[cold] = 1;
+                clockpro_move_to_head(sim, cold);
+                dlist_push_tail(&sim->cp_cold, sim->frame_prev, sim->frame_next, evict_idx);
+            }
+            continue;
+        }
+        if(sim->cp_test[cold] == 1){
+            // stays on the clock without its frame until the test period ends
+            sim->page_list[cold] = CLOCKPRO_NONRESIDENT;
+            sim->cp_nonresident++;
+            clockpro_run_hand_test(sim);
+        }else{
+            clockpro_unlink(sim, cold);
+            sim->page_list[cold] = 0;
+        }
+        return evict_idx;
+    }
+}
+
+void clockpro_hit(struct simulation* sim, int frame_idx, int vpn, int access_idx){
+    sim->cp_ref[vpn] = 1;
+}
+
+void clockpro_insert(struct simulation* sim, int frame_idx, int vpn, int access_idx){
+    sim->cp_ref[vpn] = 0;
+    if(sim->page_list[vpn] == CLOCKPRO_NONRESIDENT){
+        // re-referenced while non-resident, cold pages need more room
+        sim->cp_nonresident--;
+        if(sim->cp_cold_target < sim->num_frames - 1) sim->cp_cold_target++;
+        sim->cp_test[vpn] = 0;
+        sim->page_list[vpn] = CLOCKPRO_HOT;
+        sim->cp_hot++;
+        clockpro_move_to_head(sim, vpn);
+        clockpro_run_hand_hot(sim);
+    }else{
+        sim->cp_test[vpn] = 1;
+        sim->page_list[vpn] = CLOCKPRO_COLD;
+        clockpro_insert_at_head(sim, vpn);
+        if(sim->cp_fifo_cold == 1) dlist_push_tail(&sim->cp_cold, sim->frame_prev, sim->frame_next, sim->page_table[vpn]);
+    }
+}
+
+// sets up empty frames and the bookkeeping the chosen strategy needs
+void init_simulation(struct simulation* sim, const struct policy* policy, int num_frames, int is_verbose){
+    memset(sim, 0, sizeof(struct simulation));
+    sim->policy = policy;
+    sim->num_frames = num_frames;
+    sim->is_verbose = is_verbose;
+    if(is_verbose==1){
+        sim->event_log = open_event_log(stdout, 0);
+    }
+    sim->frame_vpn = (int*)malloc(num_frames * sizeof(int));
+    sim->frame_dirty = (char*)malloc(num_frames);
+    sim->frame_use = (char*)malloc(num_frames);
+    for(int i=0; i<num_frames; i++){
+        sim->frame_vpn[i] = -1;
+        sim->frame_dirty[i] = 0;
+        sim->frame_use[i] = -1;
+    }
+#ifdef FRAME_HISTORY
+    sim->history = (struct frame_history*)malloc(num_frames * sizeof(struct frame_history));
+    memset(sim->history, 0xff, num_frames * sizeof(struct frame_history));
+#endif
+    sim->page_table = (int*)malloc((1 << page_num_size) * sizeof(int));
+    for(int v=0; v<(1 << page_num_size); v++){
+        sim->page_table[v] = -1;
+    }
+    sim->free_frames = (int*)malloc(num_frames * sizeof(int));
+    for(int i=num_frames-1; i>=0; i--){
+        sim->free_frames[sim->free_frames_count++] = i;
+    }
+    sim->lru_head = -1;
+    sim->lru_tail = -1;
+    int seed = 5635;
+    initstate_r(seed, sim->rng_state, sizeof(sim->rng_state), &sim->rng);
+    if(policy->init != NULL){
+        policy->init(sim);
+    }
+}
+
+void free_simulation(struct simulation* sim){
+    if(sim->event_log != NULL) close_event_log(sim->event_log);
+    free(sim->frame_vpn);
+    free(sim->frame_dirty);
+    free(sim->frame_use);
+#ifdef FRAME_HISTORY
+    free(sim->history);
+#endif
+    free(sim->page_table);
+    free(sim->free_frames);
+    free(sim->opt_heap);
+    free(sim->opt_heap_pos);
+    free(sim->opt_key);
+    free(sim->fifo_queue);
+    free(sim->lru_prev);
+    free(sim->lru_next);
+    free(sim->frame_prev);
+    free(sim->frame_next);
+    free(sim->frame_list);
+    free(sim->page_prev);
+    free(sim->page_next);
+    free(sim->page_list);
+    free(sim->cp_ref);
+    free(sim->cp_test);
+}
+
+#ifdef FRAME_HISTORY
+void record_frame_access(struct simulation* sim, int frame_idx, int is_read, int now){
+    struct frame_history* h = &sim->history[frame_idx];
+    if(is_read == 1){
+        if(h->first_read == -1) h->first_read = now;
+        h->last_read = now;
+    }else{
+        if(h->first_write == -1) h->first_write = now;
+        h->last_write = now;
+    }
+    h->last_used = now;
+}
+
+// a new page was brought into frame_idx, its history starts over
+void record_frame_load(struct simulation* sim, int frame_idx, int is_read, int now){
+    struct frame_history* h = &sim->history[frame_idx];
+    h->first_read = -1;
+    h->last_read = -1;
+    h->first_write = -1;
+    h->last_write = -1;
+    h->brought_in_at = now;
+    record_frame_access(sim, frame_idx, is_read, now);
+}
+#endif
+
+// sends the simulation's evictions to a binary event log in file_name, replacing the
+// text log -verbose opened; the caller closes the file after free_simulation
+FILE* open_event_log_file(struct simulation* sim, char* file_name){
+    FILE* out = fopen(file_name, "wb");
+    if(out==NULL){
+        printf("Could not open %s for writing, exiting.. \n", file_name);
+        exit(1);
+    }
+    if(sim->event_log != NULL) close_event_log(sim->event_log);
+    sim->event_log = open_event_log(out, 1);
+    sim->is_verbose = 1;
+    return out;
+}
+
+void init_flusher(struct flusher* fl, int mode, int num_frames, int period, int expire, int high, int low){
+    memset(fl, 0, sizeof(struct flusher));
+    fl->mode = mode;
+    fl->period = period;
+    fl->expire = expire;
+    fl->next_flush = period;
+    fl->high = high;
+    fl->low = low;
+    dlist_init(&fl->dirty_list);
+    fl->dirty_prev = (int*)malloc(num_frames * sizeof(int));
+    fl->dirty_next = (int*)malloc(num_frames * sizeof(int));
+    fl->dirty_since = (int*)malloc(num_frames * sizeof(int));
+}
+
+void free_flusher(struct flusher* fl){
+    free(fl->dirty_prev);
+    free(fl->dirty_next);
+    free(fl->dirty_since);
+}
+
+// writes back the oldest dirty frames in one batch: down to low dirty frames for the
+// watermark, every frame dirty for expire accesses or more otherwise
+void flush_oldest(struct simulation* sim, int now, int watermark){
+    struct flusher* fl = sim->flusher;
+    int cleaned = 0;
+    while(fl->dirty_list.size > 0){
+        int i = fl->dirty_list.head;
+        if(watermark == 1 ? fl->dirty_list.size <= fl->low : now - fl->dirty_since[i] < fl->expire) break;
+        dlist_pop_head(&fl->dirty_list, fl->dirty_prev, fl->dirty_next);
+        sim->frame_dirty[i] = 0;
+        cleaned++;
+    }
+    if(cleaned > 0){
+        fl->background_writes += cleaned;
+        fl->batches++;
+    }
+}
+
+// frame i went from clean to dirty at access now
+void flusher_dirtied(struct simulation* sim, int i, int now){
+    struct flusher* fl = sim->flusher;
+    fl->dirty_since[i] = now;
+    dlist_push_tail(&fl->dirty_list, fl->dirty_prev, fl->dirty_next, i);
+    if(fl->mode == FLUSH_WATERMARK && fl->dirty_list.size > fl->high) flush_oldest(sim, now, 1);
+}
+
+// called before every access
+void flusher_tick(struct simulation* sim, int now){
+    struct flusher* fl = sim->flusher;
+    if(fl->mode == FLUSH_PERIODIC && now >= fl->next_flush){
+        flush_oldest(sim, now, 0);
+        fl->next_flush = now + fl->period;
+    }
+}
+
+// replays parsed_lines against one simulation, next_use must be built for OPT
+// always inlined into each strategy's run function, so with the hooks known at
+// compile time there is no indirect call or strategy check per access.
+// instrumented is a constant too, the run functions pick the copy that looks at
+// sim->stats and sim->flusher only when one of them is set, so plain runs pay nothing
+static inline __attribute__((always_inline)) void simulate(struct simulation* sim, int total_accesses,
+        access_hook on_hit, access_hook on_insert, victim_hook choose_victim, int instrumented){
+    int *frame_vpn = sim->frame_vpn;
+    char *frame_dirty = sim->frame_dirty;
+    char *frame_use = sim->frame_use;
+    struct sim_stats *stats = sim->stats;
+    int with_stats = instrumented && stats != NULL;
+    int with_flusher = instrumented && sim->flusher != NULL;
+    int *page_table = sim->page_table;
+    // counters carry on from earlier calls, -stream replays the trace batch by batch
+    // meme accesses counts the number of lines basically
+    int mem_accesses = sim->mem_accesses;
+    // writes to disk incremented at each dirty drop
+    int writes_to_disk = sim->writes_to_disk;
+    int drops_non_dirty = sim->drops_non_dirty;
+    // evictions incremented at every eviction / frames found full
+    int evictions = sim->evictions;
+    // missess incremented whenever frame not found in memory
+    int misses = sim->misses;
+    for(int j=0; j<total_accesses; j++){
+        mem_accesses++;
+        int page_num_acc = parsed_lines[j].vpn;
+        int is_read = parsed_lines[j].read;
+        int i = page_table[page_num_acc];
+        if(with_stats) stats_access(stats, page_num_acc, j);
+        if(with_flusher) flusher_tick(sim, mem_accesses - 1);
+        if(i != -1){
+            // Page found in memory
+            assert(frame_vpn[i] == page_num_acc && "page table and frame table must agree");
+            if(with_stats) stats_hit(stats, is_read);
+            if(is_read == 0){
+                // written, make it dirty
+                if(debug==1) printf("Writing %d, now DIRTY \n", frame_vpn[i]);
+                if(with_flusher && frame_dirty[i] == 0){
+                    // the flusher may clean frames as it is dirtied, so it has the last word on the bit
+                    frame_dirty[i] = 1;
+                    flusher_dirtied(sim, i, mem_accesses - 1);
+                }else{
+                    frame_dirty[i] = 1;
+                }
+            }
+#ifdef FRAME_HISTORY
+            record_frame_access(sim, i, is_read, mem_accesses - 1);
+#endif
+            frame_use[i] = 1;
+            if(on_hit != NULL) on_hit(sim, i, page_num_acc, j);
+            continue;
+        }
+        if(debug==1) printf("%s - Missed page %d in memory at access %d \n", is_read == 1 ? "READ" : "WRITE", page_num_acc, mem_accesses);
+        misses++;
+        if(with_stats) stats_miss(stats, is_read, j);
+        if(sim->tenants != NULL) sim->tenants[page_tenant[page_num_acc]].misses++;
+        int frame_idx;
+        if(sim->free_frames_count > 0){
+            // lowest numbered empty frame is at the top of the free list
+            frame_idx = sim->free_frames[--sim->free_frames_count];
+        }else{
+            evictions++;
+            // no empty frame left, will have to evict some frame
+            // find index of frame to evict according to whatever strategy is being used
+            frame_idx = choose_victim(sim, page_num_acc, j);
+            assert(frame_idx!=-1);
+            if(sim->tenants != NULL){
+                struct tenant* owner = &sim->tenants[page_tenant[frame_vpn[frame_idx]]];
+                if(frame_dirty[frame_idx]==1) owner->writes_to_disk++;
+                else owner->drops_non_dirty++;
+            }
+            if(debug==1) printf("Evicting %d, is  dirty %d \n",frame_vpn[frame_idx],frame_dirty[frame_idx]);
+            if(frame_dirty[frame_idx]==1){
+                if(debug==1) printf("dirty drop page %d\n", frame_vpn[frame_idx]);
+                writes_to_disk++;
+                if(with_flusher) dlist_remove(&sim->flusher->dirty_list, sim->flusher->dirty_prev, sim->flusher->dirty_next, frame_idx);
+                // evicting dirty page, print state accordingly
+                // evicting frame_vpn[frame_idx], bringing in page_num_acc
+                if(sim->is_verbose==1){
+                    log_eviction(sim->event_log, page_num_acc, frame_vpn[frame_idx], 1);
+                }
+            }else{
+                if(debug==1) printf("Non dirty drop page %d\n", frame_vpn[frame_idx]);
+                drops_non_dirty++;
+                // evicted page was not dirty
+                // evicting frame_vpn[frame_idx], bringing in page_num_acc
+                if(sim->is_verbose==1){
+                    log_eviction(sim->event_log, page_num_acc, frame_vpn[frame_idx], 0);
+                }
+            }
+            page_table[frame_vpn[frame_idx]] = -1;
+        }
+        // simulating bringing the page in from memory ...
+        if(debug==1) printf("page number %d is at frame no. %d \n", page_num_acc, frame_idx);
+        frame_vpn[frame_idx] = page_num_acc;
+        page_table[page_num_acc] = frame_idx;
+        frame_use[frame_idx] = 1;
+        frame_dirty[frame_idx] = is_read == 1 ? 0 : 1;
+        if(with_flusher && is_read == 0) flusher_dirtied(sim, frame_idx, mem_accesses - 1);
+#ifdef FRAME_HISTORY
+        record_frame_load(sim, frame_idx, is_read, mem_accesses - 1);
+#endif
+        if(on_insert != NULL) on_insert(sim, frame_idx, page_num_acc, j);
+    }
+    sim->mem_accesses = mem_accesses;
+    sim->misses = misses;
+    sim->writes_to_disk = writes_to_disk;
+    sim->drops_non_dirty = drops_non_dirty;
+    sim->evictions = evictions;
+}
+
+void run_opt(struct simulation* sim, int total_accesses){
+    if(sim->stats != NULL || sim->flusher != NULL) simulate(sim, total_accesses, opt_touch, opt_touch, execute_opt, 1);
+    else simulate(sim, total_accesses, opt_touch, opt_touch, execute_opt, 0);
+}
+
+void run_fifo(struct simulation* sim, int total_accesses){
+    if(sim->stats != NULL || sim->flusher != NULL) simulate(sim, total_accesses, NULL, fifo_push, execute_fifo, 1);
+    else simulate(sim, total_accesses, NULL, fifo_push, execute_fifo, 0);
+}
+
+void run_clock(struct simulation* sim, int total_accesses){
+    if(sim->stats != NULL || sim->flusher != NULL) simulate(sim, total_accesses, NULL, NULL, execute_clock, 1);
+    else simulate(sim, total_accesses, NULL, NULL, execute_clock, 0);
+}
+
+void run_lru(struct simulation* sim, int total_accesses){
+    if(sim->stats != NULL || sim->flusher != NULL) simulate(sim, total_accesses, lru_touch, lru_touch, execute_lru, 1);
+    else simulate(sim, total_accesses, lru_touch, lru_touch, execute_lru, 0);
+}
+
+void run_random(struct simulation* sim, int total_accesses){
+    if(sim->stats != NULL || sim->flusher != NULL) simulate(sim, total_accesses, NULL, NULL, execute_random, 1);
+    else simulate(sim, total_accesses, NULL, NULL, execute_random, 0);
+}
+
+void run_arc(struct simulation* sim, int total_accesses){
+    if(sim->stats != NULL || sim->flusher != NULL) simulate(sim, total_accesses, arc_hit, arc_insert, execute_arc, 1);
+    else simulate(sim, total_accesses, arc_hit, arc_insert, execute_arc, 0);
+}
+
+void run_2q(struct simulation* sim, int total_accesses){
+    if(sim->stats != NULL || sim->flusher != NULL) simulate(sim, total_accesses, twoq_hit, twoq_insert, execute_2q, 1);
+    else simulate(sim, total_accesses, twoq_hit, twoq_insert, execute_2q, 0);
+}
+
+void run_clockpro(struct simulation* sim, int total_accesses){
+    if(sim->stats != NULL || sim->flusher != NULL) simulate(sim, total_accesses, clockpro_hit, clockpro_insert, execute_clockpro, 1);
+    else simulate(sim, total_accesses, clockpro_hit, clockpro_insert, execute_clockpro, 0);
+}
+
+void run_clockpro_fifo(struct simulation* sim, int total_accesses){
+    if(sim->stats != NULL || sim->flusher != NULL) simulate(sim, total_accesses, clockpro_hit, clockpro_insert, execute_clockpro_fifo, 1);
+    else simulate(sim, total_accesses, clockpro_hit, clockpro_insert, execute_clockpro_fifo, 0);
+}
+
+// every strategy the simulator knows, a new one only needs its hooks, a run
+// function and an entry here
+const struct policy policies[] = {
+    {"OPT", init_opt, 1, run_opt},
+    {"FIFO", init_fifo, 0, run_fifo},
+    {"CLOCK", NULL, 0, run_clock},
+    {"LRU", init_lru, 0, run_lru},
+    {"RANDOM", NULL, 0, run_random},
+    {"ARC", init_adaptive, 0, run_arc},
+    {"2Q", init_adaptive, 0, run_2q},
+    {"CLOCKPRO", init_clockpro, 0, run_clockpro},
+    {"CLOCKPRO-FIFO", init_clockpro_fifo, 0, run_clockpro_fifo},
+};
+
+// NULL if no strategy goes by that name
+const struct policy* find_policy(char* name){
+    for(int p=0; p<(int)(sizeof(policies) / sizeof(policies[0])); p++){
+        if(strcmp(policies[p].name, name)==0){
+            return &policies[p];
+        }
+    }
+    return NULL;
+}
+
+// a dirty page written back in an LRU gap of distance gap_distance, whose largest gap
+// since the last write was max_gap, is written for every capacity in [max_gap, gap_distance-1]
+void add_lru_writes(int* writes_diff, int max_frames, int max_gap, int gap_distance){
+    int lo = max_gap < 1 ? 1 : max_gap;
+    int hi = gap_distance - 1 < max_frames ? gap_distance - 1 : max_frames;
+    if(lo > hi) return;
+    writes_diff[lo]++;
+    writes_diff[hi + 1]--;
+}
+
+// LRU is a stack algorithm: an access hits with C frames iff its reuse distance
+// (distinct pages touched since the previous access to the page, itself included)
+// is at most C, so one pass over the trace gives the misses for every C.
+// A page is evicted in a gap between two of its accesses iff the gap's distance
+// is above C, and the eviction is a write iff no earlier gap since its last write
+// already evicted it, which gives the writes for every C as ranges as well.
+void lru_miss_ratio_curve(int total_accesses, int max_frames, int* misses, int* writes, int* drops){
+    int num_pages = 1 << page_num_size;
+    int* tree = (int*)calloc(total_accesses + 1, sizeof(int));
+    int* last_access = (int*)malloc(num_pages * sizeof(int));
+    int* has_write = (int*)calloc(num_pages, sizeof(int));
+    int* max_gap = (int*)calloc(num_pages, sizeof(int));
+    // hist[d] counts reuse distances d, with everything above max_frames in hist[max_frames+1]
+    int* hist = (int*)calloc(max_frames + 2, sizeof(int));
+    int* writes_diff = (int*)calloc(max_frames + 2, sizeof(int));
+    for(int v=0; v<num_pages; v++){
+        last_access[v] = -1;
+    }
+    int cold_misses = 0;
+    for(int j=0; j<total_accesses; j++){
+        int vpn = parsed_lines[j].vpn;
+        int prev = last_access[vpn];
+        if(prev == -1){
+            cold_misses++;
+        }else{
+            int distance = fenwick_sum(tree, j - 1) - fenwick_sum(tree, prev) + 1;
+            fenwick_add(tree, total_accesses, prev, -1);
+            hist[distance <= max_frames ? distance : max_frames + 1]++;
+            if(has_write[vpn] == 1){
+                add_lru_writes(writes_diff, max_frames, max_gap[vpn], distance);
+            }
+            if(distance > max_gap[vpn]) max_gap[vpn] = distance;
+        }
+        if(parsed_lines[j].read == 0){
+            has_write[vpn] = 1;
+            max_gap[vpn] = 0;
+        }
+        fenwick_add(tree, total_accesses, j, 1);
+        last_access[vpn] = j;
+    }
+    // pages still dirty at the end are written only if they fell out of memory after their last access
+    int distinct_pages = fenwick_sum(tree, total_accesses - 1);
+    for(int v=0; v<num_pages; v++){
+        if(last_access[v] != -1 && has_write[v] == 1){
+            int stack_position = distinct_pages - fenwick_sum(tree, last_access[v] - 1);
+            add_lru_writes(writes_diff, max_frames, max_gap[v], stack_position);
+        }
+    }
+    int far_misses = 0;
+    for(int d=max_frames+1; d>=1; d--){
+        if(d <= max_frames){
+            misses[d] = cold_misses + far_misses;
+        }
+        far_misses += hist[d];
+    }
+    int running_writes = 0;
+    for(int c=1; c<=max_frames; c++){
+        running_writes += writes_diff[c];
+        writes[c] = running_writes;
+        // every miss after the frames fill up evicts a page
+        int fills = c < distinct_pages ? c : distinct_pages;
+        drops[c] = misses[c] - fills - writes[c];
+    }
+    free(tree);
+    free(last_access);
+    free(has_write);
+    free(max_gap);
+    free(hist);
+    free(writes_diff);
+}
+
+// Mattson's stack processing with Belady's priority: on every access the page moves
+// to the top and each level below keeps whichever of the carried page and its own
+// page is used sooner, so the top C entries are what OPT keeps with C frames.
+// Only the top max_frames levels are kept, so each access costs at most O(max_frames).
+// Which page OPT evicts among pages that are never used again doesn't change the
+// misses but does change the writes, so only misses are reported for OPT.
+void opt_miss_ratio_curve(int total_accesses, int max_frames, int* misses){
+    int num_pages = 1 << page_num_size;
+    int* stack = (int*)malloc(max_frames * sizeof(int));
+    int depth = 0;
+    // next access of each page after the current position
+    int* page_next = (int*)malloc(num_pages * sizeof(int));
+    int* hist = (int*)calloc(max_frames + 2, sizeof(int));
+    int far_misses = 0;
+    for(int j=0; j<total_accesses; j++){
+        int vpn = parsed_lines[j].vpn;
+        page_next[vpn] = next_use[j];
+        int pos = -1;
+        for(int i=0; i<depth; i++){
+            if(stack[i] == vpn){
+                pos = i;
+                break;
+            }
+        }
+        if(pos == -1){
+            far_misses++;
+        }else{
+            hist[pos + 1]++;
+            if(pos == 0) continue;
+        }
+        int carry = depth > 0 ? stack[0] : -1;
+        stack[0] = vpn;
+        int end = pos == -1 ? depth : pos;
+        for(int i=1; i<end; i++){
+            if(page_next[stack[i]] > page_next[carry]){
+                int tmp = stack[i];
+                stack[i] = carry;
+                carry = tmp;
+            }
+        }
+        if(pos != -1){
+            stack[pos] = carry;
+        }else if(depth == 0){
+            depth = 1;
+        }else if(depth < max_frames){
+            stack[depth++] = carry;
+        }
+    }
+    for(int c=max_frames; c>=1; c--){
+        misses[c] = far_misses;
+        far_misses += hist[c];
+    }
+    free(stack);
+    free(page_next);
+    free(hist);
+}
+
+// splits a comma separated list in place into a malloc'd array, returns the number of items
+int split_list(char* list, char*** items){
+    int max_items = 1;
+    for(char* c = list; *c != '\0'; c++){
+        if(*c == ',') max_items++;
+    }
+    *items = (char**)malloc(max_items * sizeof(char*));
+    int count = 0;
+    char* save = NULL;
+    for(char* tok = strtok_r(list, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)){
+        (*items)[count++] = tok;
+    }
+    return count;
+}
+
+// frames -mrc <trace file> <max frames> [LRU|OPT|LRU,OPT]
+// prints the misses (and for LRU the writes and drops) at every frame count up to max frames as csv
+int run_miss_ratio_curve(int argc, char** argv){
+    char* trace_file_name = argv[2];
+    int max_frames = atoi(argv[3]);
+    if(max_frames<=0){
+        printf("Invalid number of frames \n");
+        exit(1);
+    }
+    int want_lru = 1;
+    int want_opt = 1;
+    if(argc==5){
+        want_lru = 0;
+        want_opt = 0;
+        char** strategies;
+        int num_strategies = split_list(argv[4], &strategies);
+        for(int s=0; s<num_strategies; s++){
+            if(strcmp(strategies[s], "LRU")==0) want_lru = 1;
+            else if(strcmp(strategies[s], "OPT")==0) want_opt = 1;
+            else{
+                printf("Unknown strategy entered, exiting .... \n");
+                exit(1);
+            }
+        }
+        free(strategies);
+        if(want_lru==0 && want_opt==0){
+            printf("Unknown strategy entered, exiting .... \n");
+            exit(1);
+        }
+    }
+    int total_accesses = load_trace(trace_file_name);
+    int* lru_misses = (int*)calloc(max_frames + 1, sizeof(int));
+    int* lru_writes = (int*)calloc(max_frames + 1, sizeof(int));
+    int* lru_drops = (int*)calloc(max_frames + 1, sizeof(int));
+    int* opt_misses = (int*)calloc(max_frames + 1, sizeof(int));
+    if(want_lru==1){
+        lru_miss_ratio_curve(total_accesses, max_frames, lru_misses, lru_writes, lru_drops);
+    }
+    if(want_opt==1){
+        build_next_use(total_accesses);
+        opt_miss_ratio_curve(total_accesses, max_frames, opt_misses);
+    }
+    printf("frames,accesses");
+    if(want_lru==1) printf(",lru_misses,lru_miss_ratio,lru_writes,lru_drops");
+    if(want_opt==1) printf(",opt_misses,opt_miss_ratio");
+    printf("\n");
+    for(int c=1; c<=max_frames; c++){
+        printf("%d,%d", c, total_accesses);
+        if(want_lru==1){
+            printf(",%d,%.6f,%d,%d", lru_misses[c], total_accesses > 0 ? (double)lru_misses[c] / total_accesses : 0.0, lru_writes[c], lru_drops[c]);
+        }
+        if(want_opt==1){
+            printf(",%d,%.6f", opt_misses[c], total_accesses > 0 ? (double)opt_misses[c] / total_accesses : 0.0);
+        }
+        printf("\n");
+    }
+    free(lru_misses);
+    free(lru_writes);
+    free(lru_drops);
+    free(opt_misses);
+    return 0;
+}
+
+// spatial sampling (SHARDS) keeps a page iff its hash is below a threshold out of SHARDS_MODULUS,
+// so every access to a sampled page is seen and reuse distances can be scaled up by 1 / rate
+#define SHARDS_MODULUS (1 << 24)
+
+unsigned shards_hash(int vpn){
+    unsigned h = (unsigned)vpn;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h & (SHARDS_MODULUS - 1);
+}
+
+// sampled pages are kept in a max-heap on their hash, so when the budget is exceeded
+// the threshold drops to the largest hash and those pages stop being sampled
+struct shards_state {
+    unsigned* page_hash;
+    int* heap;
+    int heap_size;
+    int* last_time;
+    int* tree;
+    int tree_size;
+    int now;
+};
+
+void shards_heap_push(struct shards_state* st, int vpn){
+    int pos = st->heap_size++;
+    st->heap[pos] = vpn;
+    while(pos > 0 && st->page_hash[st->heap[(pos - 1) / 2]] < st->page_hash[st->heap[pos]]){
+        int tmp = st->heap[pos];
+        st->heap[pos] = st->heap[(pos - 1) / 2];
+        st->heap[(pos - 1) / 2] = tmp;
+        pos = (pos - 1) / 2;
+    }
+}
+
+int shards_heap_pop(struct shards_state* st){
+    int top = st->heap[0];
+    st->heap[0] = st->heap[--st->heap_size];
+    int pos = 0;
+    while(1){
+        int best = pos;
+        int l = 2 * pos + 1;
+        int r = 2 * pos + 2;
+        if(l < st->heap_size && st->page_hash[st->heap[l]] > st->page_hash[st->heap[best]]) best = l;
+        if(r < st->heap_size && st->page_hash[st->heap[r]] > st->page_hash[st->heap[best]]) best = r;
+        if(best == pos) break;
+        int tmp = st->heap[pos];
+        st->heap[pos] = st->heap[best];
+        st->heap[best] = tmp;
+        pos = best;
+    }
+    return top;
+}
+
+int compare_last_time(const void* a, const void* b, void* arg){
+    int* last_time = (int*)arg;
+    return last_time[*(const int*)a] - last_time[*(const int*)b];
+}
+
+// timestamps only grow, so once they run out renumber the sampled pages by
+// last access and rebuild the Fenwick tree; happens at most once per budget accesses
+void shards_compact(struct shards_state* st){
+    int* order = (int*)malloc((st->heap_size > 0 ? st->heap_size : 1) * sizeof(int));
+    memcpy(order, st->heap, st->heap_size * sizeof(int));
+    qsort_r(order, st->heap_size, sizeof(int), compare_last_time, st->last_time);
+    memset(st->tree, 0, (st->tree_size + 1) * sizeof(int));
+    for(int i=0; i<st->heap_size; i++){
+        st->last_time[order[i]] = i;
+        fenwick_add(st->tree, st->tree_size, i, 1);
+    }
+    st->now = st->heap_size;
+    free(order);
+}
+
+// estimates the LRU miss ratio at every frame count from 1 to max_frames using only the
+// accesses to sampled pages; at most max_pages pages are tracked, lowering the rate if needed.
+// each sampled access is weighted by 1 / rate at the time it was seen, so every access of
+// the trace is expected to contribute 1. SHARDS_adj: a few hot pages falling in or out of the
+// sample move the weighted total away from that, and the difference is mostly hits at
+// tiny distances, so it goes into the smallest distance bucket before normalizing
+void sampled_lru_miss_ratio_curve(int total_accesses, int max_frames, double rate, int max_pages, double* miss_ratio, int* sampled_accesses, double* final_rate){
+    int num_pages = 1 << page_num_size;
+    unsigned threshold = (unsigned)(rate * SHARDS_MODULUS);
+    if(threshold > SHARDS_MODULUS) threshold = SHARDS_MODULUS;
+    struct shards_state st;
+    st.page_hash = (unsigned*)malloc(num_pages * sizeof(unsigned));
+    st.heap = (int*)malloc((max_pages + 1) * sizeof(int));
+    st.heap_size = 0;
+    st.last_time = (int*)malloc(num_pages * sizeof(int));
+    // room for twice the budget before timestamps have to be compacted
+    st.tree_size = 2 * (max_pages + 1);
+    st.tree = (int*)calloc(st.tree_size + 1, sizeof(int));
+    st.now = 0;
+    for(int v=0; v<num_pages; v++){
+        st.last_time[v] = -1;
+    }
+    // hist[d] holds the weighted accesses with scaled reuse distance d, above max_frames in hist[max_frames+1]
+    double* hist = (double*)calloc(max_frames + 2, sizeof(double));
+    double cold = 0;
+    int sampled = 0;
+    for(int j=0; j<total_accesses; j++){
+        int vpn = parsed_lines[j].vpn;
+        unsigned h = shards_hash(vpn);
+        if(h >= threshold) continue;
+        sampled++;
+        double weight = (double)SHARDS_MODULUS / threshold;
+        int prev = st.last_time[vpn];
+        if(prev == -1){
+            cold += weight;
+            st.page_hash[vpn] = h;
+            shards_heap_push(&st, vpn);
+        }else{
+            int distance = fenwick_sum(st.tree, st.now - 1) - fenwick_sum(st.tree, prev) + 1;
+            fenwick_add(st.tree, st.tree_size, prev, -1);
+            // the page itself is always counted, only the other pages in between are sampled
+            double scaled = 1 + (distance - 1) * weight;
+            hist[scaled <= max_frames ? (int)scaled : max_frames + 1] += weight;
+        }
+        if(st.now == st.tree_size){
+            // this page's old mark is already gone, keep it out of the renumbering
+            st.last_time[vpn] = -1;
+            shards_compact(&st);
+        }
+        fenwick_add(st.tree, st.tree_size, st.now, 1);
+        st.last_time[vpn] = st.now;
+        st.now++;
+        if(st.heap_size > max_pages){
+            threshold = st.page_hash[st.heap[0]];
+            while(st.heap_size > 0 && st.page_hash[st.heap[0]] >= threshold){
+                int dropped = shards_heap_pop(&st);
+                fenwick_add(st.tree, st.tree_size, st.last_time[dropped], -1);
+                st.last_time[dropped] = -1;
+            }
+        }
+    }
+    double weighted_total = cold;
+    for(int d=1; d<=max_frames+1; d++){
+        weighted_total += hist[d];
+    }
+    hist[1] += total_accesses - weighted_total;
+    weighted_total = total_accesses;
+    double far_misses = cold;
+    for(int d=max_frames+1; d>=1; d--){
+        if(d <= max_frames){
+            miss_ratio[d] = weighted_total > 0 ? far_misses / weighted_total : 0.0;
+            if(miss_ratio[d] > 1.0) miss_ratio[d] = 1.0;
+        }
+        far_misses += hist[d];
+    }
+    *sampled_accesses = sampled;
+    *final_rate = (double)threshold / SHARDS_MODULUS;
+    free(st.page_hash);
+    free(st.heap);
+    free(st.last_time);
+    free(st.tree);
+    free(hist);
+}
+
+// frames -shards <trace file> <max frames> <sampling rate> [max sampled pages] [-exact]
+// prints the sampled LRU miss ratio curve as csv, with -exact also the exact curve and the error
+int run_sampled_miss_ratio_curve(int argc, char** argv){
+    char* trace_file_name = argv[2];
+    int max_frames = atoi(argv[3]);
+    double rate = atof(argv[4]);
+    if(max_frames<=0){
+        printf("Invalid number of frames \n");
+        exit(1);
+    }
+    if(rate<=0 || rate>1){
+        printf("Sampling rate must be in (0, 1] \n");
+        exit(1);
+    }
+    int max_pages = 1 << page_num_size;
+    int with_exact = 0;
+    for(int i=5; i<argc; i++){
+        if(strcmp(argv[i], "-exact")==0){
+            with_exact = 1;
+        }else{
+            max_pages = atoi(argv[i]);
+            if(max_pages<=0){
+                printf("Invalid number of sampled pages \n");
+                exit(1);
+            }
+        }
+    }
+    int total_accesses = load_trace(trace_file_name);
+    double* miss_ratio = (double*)calloc(max_frames + 1, sizeof(double));
+    int sampled_accesses = 0;
+    double final_rate = rate;
+    sampled_lru_miss_ratio_curve(total_accesses, max_frames, rate, max_pages, miss_ratio, &sampled_accesses, &final_rate);
+    int* exact_misses = NULL;
+    if(with_exact==1){
+        exact_misses = (int*)calloc(max_frames + 1, sizeof(int));
+        int* exact_writes = (int*)calloc(max_frames + 1, sizeof(int));
+        int* exact_drops = (int*)calloc(max_frames + 1, sizeof(int));
+        lru_miss_ratio_curve(total_accesses, max_frames, exact_misses, exact_writes, exact_drops);
+        free(exact_writes);
+        free(exact_drops);
+    }
+    printf("frames,accesses,lru_miss_ratio,lru_misses");
+    if(with_exact==1) printf(",exact_lru_miss_ratio,abs_error");
+    printf("\n");
+    double total_error = 0;
+    double max_error = 0;
+    // below about 1 / rate frames a single sampled page in between already counts as
+    // more than the cache holds, so the error is also reported from there on
+    int resolved_from = (int)(1.0 / final_rate) + 1;
+    double resolved_error = 0;
+    double resolved_max_error = 0;
+    for(int c=1; c<=max_frames; c++){
+        printf("%d,%d,%.6f,%.0f", c, total_accesses, miss_ratio[c], miss_ratio[c] * total_accesses);
+        if(with_exact==1){
+            double exact = total_accesses > 0 ? (double)exact_misses[c] / total_accesses : 0.0;
+            double error = miss_ratio[c] > exact ? miss_ratio[c] - exact : exact - miss_ratio[c];
+            total_error += error;
+            if(error > max_error) max_error = error;
+            if(c >= resolved_from){
+                resolved_error += error;
+                if(error > resolved_max_error) resolved_max_error = error;
+            }
+            printf(",%.6f,%.6f", exact, error);
+        }
+        printf("\n");
+    }
+    fprintf(stderr, "Sampled %d of %d accesses, final sampling rate %.6f \n", sampled_accesses, total_accesses, final_rate);
+    if(with_exact==1){
+        fprintf(stderr, "Mean absolute error %.6f, max absolute error %.6f \n", total_error / max_frames, max_error);
+        if(resolved_from <= max_frames){
+            fprintf(stderr, "From %d frames on: mean absolute error %.6f, max absolute error %.6f \n", resolved_from,
+                resolved_error / (max_frames - resolved_from + 1), resolved_max_error);
+        }
+    }
+    free(miss_ratio);
+    free(exact_misses);
+    return 0;
+}
+
+// the (strategy, frames) pairs of a sweep, handed out to worker threads in order
+struct sweep {
+    struct simulation* sims;
+    int num_sims;
+    int next_sim;
+    int total_accesses;
+    pthread_mutex_t lock;
+};
+
+void* sweep_worker(void* arg){
+    struct sweep* sw = (struct sweep*)arg;
+    while(1){
+        pthread_mutex_lock(&sw->lock);
+        int idx = sw->next_sim++;
+        pthread_mutex_unlock(&sw->lock);
+        if(idx >= sw->num_sims) break;
+        struct simulation* sim = &sw->sims[idx];
+        // frames etc. are only allocated while the simulation runs so memory stays bounded by the thread count
+        const struct policy* policy = sim->policy;
+        int num_frames = sim->num_frames;
+        init_simulation(sim, policy, num_frames, 0);
+        policy->run(sim, sw->total_accesses);
+        free_simulation(sim);
+    }
+    return NULL;
+}
+
+void print_sweep_matrix(char* title, struct simulation* sims, char** strategies, int num_strategies, int* frame_counts, int num_frame_counts, int which){
+    printf("%s\n%10s", title, "frames");
+    for(int s=0; s<num_strategies; s++){
+        printf(" %10s", strategies[s]);
+    }
+    printf("\n");
+    for(int f=0; f<num_frame_counts; f++){
+        printf("%10d", frame_counts[f]);
+        for(int s=0; s<num_strategies; s++){
+            struct simulation* sim = &sims[f * num_strategies + s];
+            int value = which == 0 ? sim->misses : which == 1 ? sim->writes_to_disk : sim->drops_non_dirty;
+            printf(" %10d", value);
+        }
+        printf("\n");
+    }
+}
+
+// frames -sweep <trace file> <frames,frames,...> <strategy,strategy,...> [threads]
+// parses the trace once and runs every (strategy, frames) pair on a pool of threads
+int run_sweep(int argc, char** argv){
+    char* trace_file_name = argv[2];
+    char** frame_items;
+    char** strategies;
+    int num_frame_counts = split_list(argv[3], &frame_items);
+    int num_strategies = split_list(argv[4], &strategies);
+    int* frame_counts = (int*)malloc(num_frame_counts * sizeof(int));
+    for(int f=0; f<num_frame_counts; f++){
+        frame_counts[f] = atoi(frame_items[f]);
+        if(frame_counts[f]<=0){
+            printf("Invalid number of frames \n");
+            exit(1);
+        }
+    }
+    int needs_next_use = 0;
+    const struct policy** sweep_policies = (const struct policy**)malloc(num_strategies * sizeof(struct policy*));
+    for(int s=0; s<num_strategies; s++){
+        sweep_policies[s] = find_policy(strategies[s]);
+        if(sweep_policies[s] == NULL){
+            printf("Unknown strategy entered, exiting .... \n");
+            exit(1);
+        }
+        if(sweep_policies[s]->needs_next_use == 1) needs_next_use = 1;
+    }
+    int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if(argc==6) num_threads = atoi(argv[5]);
+    if(num_threads<=0) num_threads = 1;
+    int total_accesses = load_trace(trace_file_name);
+    if(needs_next_use==1) build_next_use(total_accesses);
+    struct sweep sw;
+    sw.num_sims = num_frame_counts * num_strategies;
+    sw.sims = (struct simulation*)calloc(sw.num_sims, sizeof(struct simulation));
+    sw.next_sim = 0;
+    sw.total_accesses = total_accesses;
+    pthread_mutex_init(&sw.lock, NULL);
+    for(int f=0; f<num_frame_counts; f++){
+        for(int s=0; s<num_strategies; s++){
+            sw.sims[f * num_strategies + s].policy = sweep_policies[s];
+            sw.sims[f * num_strategies + s].num_frames = frame_counts[f];
+        }
+    }
+    if(num_threads > sw.num_sims) num_threads = sw.num_sims;
+    pthread_t* threads = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
+    for(int t=0; t<num_threads; t++){
+        pthread_create(&threads[t], NULL, sweep_worker, &sw);
+    }
+    for(int t=0; t<num_threads; t++){
+        pthread_join(threads[t], NULL);
+    }
+    printf("Number of memory accesses: %d\n", total_accesses);
+    print_sweep_matrix("Number of misses", sw.sims, strategies, num_strategies, frame_counts, num_frame_counts, 0);
+    print_sweep_matrix("Number of writes", sw.sims, strategies, num_strategies, frame_counts, num_frame_counts, 1);
+    print_sweep_matrix("Number of drops", sw.sims, strategies, num_strategies, frame_counts, num_frame_counts, 2);
+    pthread_mutex_destroy(&sw.lock);
+    free(threads);
+    free(sw.sims);
+    free(frame_items);
+    free(strategies);
+    free(sweep_policies);
+    free(frame_counts);
+    return 0;
+}
+
+// frames -tenants <trace file> <number of frames> <strategy> <global|partition|wss> [-quota q,q,...] [-tau N]
+// all tenants of a "<asid> <hex address> <R|W>" trace share the frames:
+// global: the strategy picks victims among all resident pages, whoever owns them
+// partition: every tenant gets a fixed quota of frames (an even split unless -quota
+// gives one per tenant in asid order) and the strategy only replaces within it
+// wss: frames follow the working sets; a tenant holding more frames than the pages it
+// touched in the last tau accesses of the trace gives up its least recently used page
+// first, otherwise the missing tenant replaces its own; only LRU fits that, so the
+// strategy must be LRU
+#define TENANT_DEFAULT_TAU 100000
+
+void run_tenants_global(const struct policy* policy, int num_frames, int total_accesses){
+    struct simulation sim;
+    init_simulation(&sim, policy, num_frames, 0);
+    sim.tenants = tenants;
+    if(policy->needs_next_use==1){
+        build_next_use(total_accesses);
+    }
+    policy->run(&sim, total_accesses);
+    for(int i=0; i<num_frames; i++){
+        if(sim.frame_vpn[i] != -1) tenants[page_tenant[sim.frame_vpn[i]]].resident++;
+    }
+    free_simulation(&sim);
+}
+
+void run_tenants_partitioned(const struct policy* policy, int total_accesses){
+    // group the trace by tenant, keeping the order within each tenant
+    struct parsed_line* all = parsed_lines;
+    struct parsed_line* grouped = (struct parsed_line*)malloc((total_accesses > 0 ? total_accesses : 1) * sizeof(struct parsed_line));
+    int *start = (int*)calloc(num_tenants + 1, sizeof(int));
+    for(int t=0; t<num_tenants; t++){
+        start[t + 1] = start[t] + tenants[t].accesses;
+    }
+    int *fill = (int*)malloc((num_tenants > 0 ? num_tenants : 1) * sizeof(int));
+    memcpy(fill, start, num_tenants * sizeof(int));
+    for(int j=0; j<total_accesses; j++){
+        grouped[fill[page_tenant[all[j].vpn]]++] = all[j];
+    }
+    for(int t=0; t<num_tenants; t++){
+        parsed_lines = grouped + start[t];
+        struct simulation sim;
+        init_simulation(&sim, policy, tenants[t].quota, 0);
+        if(policy->needs_next_use==1){
+            free(next_use);
+            build_next_use(tenants[t].accesses);
+        }
+        policy->run(&sim, tenants[t].accesses);
+        tenants[t].misses = sim.misses;
+        tenants[t].writes_to_disk = sim.writes_to_disk;
+        tenants[t].drops_non_dirty = sim.drops_non_dirty;
+        tenants[t].resident = sim.num_frames - sim.free_frames_count;
+        free_simulation(&sim);
+    }
+    parsed_lines = all;
+    free(grouped);
+    free(start);
+    free(fill);
+}
+
+// tenant that gives up a frame when tenant t misses with no frame free
+int choose_victim_tenant(int t){
+    int victim = -1;
+    int most_excess = 0;
+    for(int u=0; u<num_tenants; u++){
+        int excess = tenants[u].lru.size - tenants[u].working_set;
+        if(tenants[u].lru.size > 0 && excess > most_excess){
+            victim = u;
+            most_excess = excess;
+        }
+    }
+    if(victim != -1) return victim;
+    if(tenants[t].lru.size > 0) return t;
+    for(int u=0; u<num_tenants; u++){
+        if(victim == -1 || tenants[u].lru.size > tenants[victim].lru.size) victim = u;
+    }
+    return victim;
+}
+
+void run_tenants_working_set(int num_frames, int total_accesses, int tau){
+    int *frame_vpn = (int*)malloc(num_frames * sizeof(int));
+    char *frame_dirty = (char*)malloc(num_frames);
+    int *lru_prev = (int*)malloc(num_frames * sizeof(int));
+    int *lru_next = (int*)malloc(num_frames * sizeof(int));
+    int *page_table = (int*)malloc((1 << page_num_size) * sizeof(int));
+    for(int v=0; v<(1 << page_num_size); v++){
+        page_table[v] = -1;
+    }
+    // references of every page inside the sliding window of tau accesses
+    int *in_window = (int*)calloc(1 << page_num_size, sizeof(int));
+    for(int t=0; t<num_tenants; t++){
+        dlist_init(&tenants[t].lru);
+    }
+    int next_free = 0;
+    for(int j=0; j<total_accesses; j++){
+        int vpn = parsed_lines[j].vpn;
+        int is_read = parsed_lines[j].read;
+        struct tenant* owner = &tenants[page_tenant[vpn]];
+        if(in_window[vpn]++ == 0) owner->working_set++;
+        if(j >= tau){
+            int old = parsed_lines[j - tau].vpn;
+            if(--in_window[old] == 0) tenants[page_tenant[old]].working_set--;
+        }
+        int i = page_table[vpn];
+        if(i != -1){
+            if(is_read == 0) frame_dirty[i] = 1;
+            // move to the most recently used end of its tenant's list
+            dlist_remove(&owner->lru, lru_prev, lru_next, i);
+            dlist_push_tail(&owner->lru, lru_prev, lru_next, i);
+            continue;
+        }
+        owner->misses++;
+        if(next_free < num_frames){
+            i = next_free++;
+        }else{
+            struct tenant* victim = &tenants[choose_victim_tenant(page_tenant[vpn])];
+            i = dlist_pop_head(&victim->lru, lru_prev, lru_next);
+            if(frame_dirty[i]==1) victim->writes_to_disk++;
+            else victim->drops_non_dirty++;
+            page_table[frame_vpn[i]] = -1;
+        }
+        frame_vpn[i] = vpn;
+        frame_dirty[i] = is_read == 1 ? 0 : 1;
+        page_table[vpn] = i;
+        dlist_push_tail(&owner->lru, lru_prev, lru_next, i);
+    }
+    for(int t=0; t<num_tenants; t++){
+        tenants[t].resident = tenants[t].lru.size;
+    }
+    free(frame_vpn);
+    free(frame_dirty);
+    free(lru_prev);
+    free(lru_next);
+    free(page_table);
+    free(in_window);
+}
+
+int run_tenants(int argc, char** argv){
+    char* trace_file_name = argv[2];
+    int num_frames = atoi(argv[3]);
+    if(num_frames<=0){
+        printf("Invalid number of frames \n");
+        exit(1);
+    }
+    const struct policy* policy = find_policy(argv[4]);
+    if(policy == NULL){
+        printf("Unknown strategy entered, exiting .... \n");
+        exit(1);
+    }
+    char* mode = argv[5];
+    if(strcmp(mode, "global")!=0 && strcmp(mode, "partition")!=0 && strcmp(mode, "wss")!=0){
+        printf("Unknown replacement scope %s, use global, partition or wss \n", mode);
+        exit(1);
+    }
+    if(strcmp(mode, "wss")==0 && strcmp(policy->name, "LRU")!=0){
+        printf("wss replacement evicts a tenant's least recently used page, use LRU \n");
+        exit(1);
+    }
+    char* quota_list = NULL;
+    int tau = TENANT_DEFAULT_TAU;
+    for(int a=6; a<argc; a++){
+        if(strcmp(argv[a], "-quota")==0 && a+1<argc){
+            quota_list = argv[++a];
+        }else if(strcmp(argv[a], "-tau")==0 && a+1<argc){
+            tau = atoi(argv[++a]);
+        }
+    }
+    if(tau<=0){
+        printf("Invalid working set window \n");
+        exit(1);
+    }
+    int total_accesses = read_trace_file(trace_file_name, 1);
+    if(strcmp(mode, "partition")==0){
+        int assigned = 0;
+        if(quota_list != NULL){
+            char** quotas;
+            int num_quotas = split_list(quota_list, &quotas);
+            if(num_quotas != num_tenants){
+                printf("Trace has %d tenants but %d quotas were given \n", num_tenants, num_quotas);
+                exit(1);
+            }
+            for(int t=0; t<num_tenants; t++){
+                tenants[t].quota = atoi(quotas[t]);
+                assigned += tenants[t].quota;
+            }
+            free(quotas);
+        }else{
+            for(int t=0; t<num_tenants; t++){
+                tenants[t].quota = num_frames / num_tenants + (t < num_frames % num_tenants ? 1 : 0);
+                assigned += tenants[t].quota;
+            }
+        }
+        for(int t=0; t<num_tenants; t++){
+            if(tenants[t].quota<=0){
+                printf("Every tenant needs at least one frame, tenant %d has %d \n", tenants[t].asid, tenants[t].quota);
+                exit(1);
+            }
+        }
+        if(assigned > num_frames){
+            printf("Quotas add up to %d frames, only %d exist \n", assigned, num_frames);
+            exit(1);
+        }
+        run_tenants_partitioned(policy, total_accesses);
+    }else if(strcmp(mode, "global")==0){
+        run_tenants_global(policy, num_frames, total_accesses);
+    }else{
+        run_tenants_working_set(num_frames, total_accesses, tau);
+    }
+    int misses = 0;
+    int writes_to_disk = 0;
+    int drops_non_dirty = 0;
+    for(int t=0; t<num_tenants; t++){
+        misses += tenants[t].misses;
+        writes_to_disk += tenants[t].writes_to_disk;
+        drops_non_dirty += tenants[t].drops_non_dirty;
+    }
+    print_state(total_accesses, misses, writes_to_disk, drops_non_dirty);
+    for(int t=0; t<num_tenants; t++){
+        struct tenant* tn = &tenants[t];
+        printf("Tenant %d: accesses %d, misses %d (%.4f), writes %d, drops %d, frames %d \n", tn->asid, tn->accesses,
+            tn->misses, tn->accesses > 0 ? (double)tn->misses / tn->accesses : 0.0, tn->writes_to_disk, tn->drops_non_dirty, tn->resident);
+    }
+    return 0;
+}
+
+// frames -hugepages <trace file> <number of frames> [promotion threshold]
+// mixed page sizes: the frames are base pages, and every aligned 2 MiB region can also
+// be mapped as one huge page taking region_pages frames. a region is promoted on a
+// fault once it would have threshold base pages resident (half the region by
+// default); its resident base pages fold into the huge page, the rest are read in with
+// it. huge pages are evicted whole, one write back if any part of them was written.
+// replacement is LRU over base and huge pages alike, evicting until the new page fits.
+// the same trace is run with base pages only to show what huge pages saved
+#define HUGE_PAGE_SHIFT 21
+
+struct huge_page_run {
+    int faults;
+    int writes_to_disk;
+    int drops_non_dirty;
+    int promotions;
+    int huge_evictions;
+    long long bytes_read;
+    long long bytes_written;
+};
+
+// threshold 0 never promotes
+void simulate_huge_pages(int num_frames, int total_accesses, int threshold, int *region_of, int num_regions, struct huge_page_run* run){
+    int region_pages = 1 << (HUGE_PAGE_SHIFT - page_frame_size);
+    long long page_bytes = 1LL << page_frame_size;
+    int num_pages = 1 << page_num_size;
+    // units are pages 0..num_pages-1 and huge pages num_pages + region
+    int num_units = num_pages + num_regions;
+    int *lru_prev = (int*)malloc(num_units * sizeof(int));
+    int *lru_next = (int*)malloc(num_units * sizeof(int));
+    char *resident = (char*)calloc(num_units, sizeof(char));
+    char *dirty = (char*)calloc(num_units, sizeof(char));
+    // resident base pages of every region, linked through region_prev/region_next
+    struct dlist *region_list = (struct dlist*)malloc((num_regions > 0 ? num_regions : 1) * sizeof(struct dlist));
+    int *region_prev = (int*)malloc(num_pages * sizeof(int));
+    int *region_next = (int*)malloc(num_pages * sizeof(int));
+    for(int r=0; r<num_regions; r++){
+        dlist_init(&region_list[r]);
+    }
+    struct dlist lru;
+    dlist_init(&lru);
+    memset(run, 0, sizeof(struct huge_page_run));
+    int free_frames = num_frames;
+    for(int j=0; j<total_accesses; j++){
+        int vpn = parsed_lines[j].vpn;
+        int is_read = parsed_lines[j].read;
+        int r = region_of[vpn];
+        int huge = num_pages + r;
+        int unit = resident[huge] == 1 ? huge : vpn;
+        if(resident[unit] == 1){
+            if(is_read == 0) dirty[unit] = 1;
+            dlist_remove(&lru, lru_prev, lru_next, unit);
+            dlist_push_tail(&lru, lru_prev, lru_next, unit);
+            continue;
+        }
+        run->faults++;
+        int need = 1;
+        if(threshold > 0 && region_pages <= num_frames && region_list[r].size + 1 >= threshold){
+            // the region's base pages become part of the huge page
+            unit = huge;
+            dirty[huge] = is_read == 0;
+            run->bytes_read += (region_pages - region_list[r].size) * page_bytes;
+            while(region_list[r].size > 0){
+                int page = dlist_pop_head(&region_list[r], region_prev, region_next);
+                dlist_remove(&lru, lru_prev, lru_next, page);
+                if(dirty[page] == 1) dirty[huge] = 1;
+                resident[page] = 0;
+                free_frames++;
+            }
+            need = region_pages;
+            run->promotions++;
+        }else{
+            dirty[vpn] = is_read == 0;
+            run->bytes_read += page_bytes;
+        }
+        while(free_frames < need){
+            int victim = dlist_pop_head(&lru, lru_prev, lru_next);
+            resident[victim] = 0;
+            long long victim_bytes = page_bytes;
+            if(victim >= num_pages){
+                free_frames += region_pages;
+                victim_bytes = region_pages * page_bytes;
+                run->huge_evictions++;
+            }else{
+                free_frames++;
+                dlist_remove(&region_list[region_of[victim]], region_prev, region_next, victim);
+            }
+            if(dirty[victim] == 1){
+                run->writes_to_disk++;
+                run->bytes_written += victim_bytes;
+            }else{
+                run->drops_non_dirty++;
+            }
+        }
+        free_frames -= need;
+        resident[unit] = 1;
+        dlist_push_tail(&lru, lru_prev, lru_next, unit);
+        if(unit == vpn) dlist_push_tail(&region_list[r], region_prev, region_next, vpn);
+    }
+    free(lru_prev);
+    free(lru_next);
+    free(resident);
+    free(dirty);
+    free(region_list);
+    free(region_prev);
+    free(region_next);
+}
+
+void print_huge_page_run(char* label, struct huge_page_run* run){
+    printf("%s: faults %d, writes %d, drops %d, promotions %d, huge page evictions %d, read %.1f MiB, written %.1f MiB \n",
+        label, run->faults, run->writes_to_disk, run->drops_non_dirty, run->promotions, run->huge_evictions,
+        run->bytes_read / 1048576.0, run->bytes_written / 1048576.0);
+}
+
+int run_huge_pages(int argc, char** argv){
+    char* trace_file_name = argv[2];
+    int num_frames = atoi(argv[3]);
+    if(num_frames<=0){
+        printf("Invalid number of frames \n");
+        exit(1);
+    }
+    if(page_frame_size >= HUGE_PAGE_SHIFT){
+        printf("Base pages must be smaller than 2 MiB huge pages \n");
+        exit(1);
+    }
+    int region_pages = 1 << (HUGE_PAGE_SHIFT - page_frame_size);
+    int threshold = argc>=5 ? atoi(argv[4]) : region_pages / 2;
+    if(threshold<=0 || threshold>region_pages){
+        printf("Promotion threshold must be between 1 and %d base pages \n", region_pages);
+        exit(1);
+    }
+    int total_accesses = load_trace(trace_file_name);
+    // number the 2 MiB regions the trace touches
+    int *region_of = (int*)malloc((1 << page_num_size) * sizeof(int));
+    struct id_map regions;
+    init_id_map(&regions, page_num_size + 1);
+    for(int j=0; j<total_accesses; j++){
+        int vpn = parsed_lines[j].vpn;
+        region_of[vpn] = map_id(&regions, page_number(vpn) >> (HUGE_PAGE_SHIFT - page_frame_size), 1 << page_num_size);
+    }
+    struct huge_page_run base_only;
+    struct huge_page_run mixed;
+    simulate_huge_pages(num_frames, total_accesses, 0, region_of, regions.count, &base_only);
+    simulate_huge_pages(num_frames, total_accesses, threshold, region_of, regions.count, &mixed);
+    printf("Number of memory accesses: %d \n", total_accesses);
+    printf("%d byte pages, %d frames, promotion at %d of %d pages \n", 1 << page_frame_size, num_frames, threshold, region_pages);
+    print_huge_page_run("Base pages only", &base_only);
+    print_huge_page_run("With 2MiB pages", &mixed);
+    printf("Huge pages saved %d faults and %d writes \n", base_only.faults - mixed.faults, base_only.writes_to_disk - mixed.writes_to_disk);
+    free(region_of);
+    free(regions.keys);
+    free(regions.ids);
+    return 0;
+}
+
+// frames -writeback <trace file> <number of frames> <strategy,strategy,...|all> [-flush periodic|watermark]
+//        [-period N] [-expire N] [-high percent] [-low percent] [-cost read,write,batch,batch page]
+// estimates the time faults stall on the device. every miss waits for a read, and one
+// that evicts a dirty frame also waits for that write; a background flusher cleans
+// dirty frames ahead of eviction so fewer misses pay for a write, at the price of
+// writing pages that get dirty again. flushed pages go out in batches that cost a
+// fixed batch time plus a time per page and run in the background, so they are
+// reported as device time but not as stall. costs are in microseconds.
+// every strategy is run without a flusher and, if -flush is given, with it
+#define WRITEBACK_DEFAULT_PERIOD 50000
+#define WRITEBACK_DEFAULT_EXPIRE 30000
+
+struct io_cost {
+    double read_us;
+    double write_us;
+    double batch_us;
+    double batch_page_us;
+};
+
+void print_writeback_row(struct simulation* sim, char* flusher_name, struct io_cost* cost){
+    int background_writes = sim->flusher != NULL ? sim->flusher->background_writes : 0;
+    int batches = sim->flusher != NULL ? sim->flusher->batches : 0;
+    double stall_us = sim->misses * cost->read_us + sim->writes_to_disk * cost->write_us;
+    double background_us = batches * cost->batch_us + background_writes * cost->batch_page_us;
+    printf("%s,%d,%s,%d,%d,%d,%d,%d,%.3f,%.3f,%.3f\n", sim->policy->name, sim->num_frames, flusher_name,
+        sim->misses, sim->writes_to_disk, sim->drops_non_dirty, background_writes, batches,
+        stall_us / 1000, sim->misses > 0 ? stall_us / sim->misses : 0.0, background_us / 1000);
+}
+
+int run_writeback(int argc, char** argv){
+    char* trace_file_name = argv[2];
+    int num_frames = atoi(argv[3]);
+    if(num_frames<=0){
+        printf("Invalid number of frames \n");
+        exit(1);
+    }
+    int num_policies = sizeof(policies) / sizeof(policies[0]);
+    const struct policy** run_policies = (const struct policy**)malloc(num_policies * sizeof(struct policy*));
+    int num_run_policies = 0;
+    char** strategies = NULL;
+    if(strcmp(argv[4], "all")==0){
+        for(int p=0; p<num_policies; p++){
+            run_policies[num_run_policies++] = &policies[p];
+        }
+    }else{
+        int num_strategies = split_list(argv[4], &strategies);
+        for(int s=0; s<num_strategies; s++){
+            run_policies[num_run_policies] = find_policy(strategies[s]);
+            if(run_policies[num_run_policies] == NULL){
+                printf("Unknown strategy entered, exiting .... \n");
+                exit(1);
+            }
+            num_run_policies++;
+        }
+    }
+    int mode = 0;
+    char* flusher_name = "none";
+    int period = WRITEBACK_DEFAULT_PERIOD;
+    int expire = WRITEBACK_DEFAULT_EXPIRE;
+    int high_percent = 20;
+    int low_percent = 10;
+    // a fast SSD: 100us to read or write a page alone, batches pay 100us once and 10us a page
+    struct io_cost cost = {100, 100, 100, 10};
+    for(int a=5; a<argc; a++){
+        if(strcmp(argv[a], "-flush")==0 && a+1<argc){
+            flusher_name = argv[++a];
+            if(strcmp(flusher_name, "periodic")==0) mode = FLUSH_PERIODIC;
+            else if(strcmp(flusher_name, "watermark")==0) mode = FLUSH_WATERMARK;
+            else{
+                printf("Unknown flusher %s, use periodic or watermark \n", flusher_name);
+                exit(1);
+            }
+        }else if(strcmp(argv[a], "-period")==0 && a+1<argc){
+            period = atoi(argv[++a]);
+        }else if(strcmp(argv[a], "-expire")==0 && a+1<argc){
+            expire = atoi(argv[++a]);
+        }else if(strcmp(argv[a], "-high")==0 && a+1<argc){
+            high_percent = atoi(argv[++a]);
+        }else if(strcmp(argv[a], "-low")==0 && a+1<argc){
+            low_percent = atoi(argv[++a]);
+        }else if(strcmp(argv[a], "-cost")==0 && a+1<argc){
+            if(sscanf(argv[++a], "%lf,%lf,%lf,%lf", &cost.read_us, &cost.write_us, &cost.batch_us, &cost.batch_page_us) != 4){
+                printf("-cost takes read,write,batch,batch page times in microseconds \n");
+                exit(1);
+            }
+        }
+    }
+    if(period<=0 || expire<0 || low_percent<0 || high_percent>100 || low_percent>=high_percent){
+        printf("Invalid flusher settings \n");
+        exit(1);
+    }
+    int high = (int)((long long)num_frames * high_percent / 100);
+    int low = (int)((long long)num_frames * low_percent / 100);
+    // with few frames low rounds down to 0; keep at least the newest dirty frame so a
+    // watermark flush never cleans the frame whose write triggered it, and keep high
+    // above low so a flush always cleans more than the one page that crossed high
+    if(low < 1) low = 1;
+    if(high <= low) high = low + 1;
+    int total_accesses = load_trace(trace_file_name);
+    printf("strategy,frames,flusher,misses,sync_writes,drops,background_writes,flush_batches,stall_ms,stall_us_per_miss,background_ms\n");
+    for(int p=0; p<num_run_policies; p++){
+        const struct policy* policy = run_policies[p];
+        if(policy->needs_next_use==1 && next_use == NULL){
+            build_next_use(total_accesses);
+        }
+        for(int with_flusher=0; with_flusher<=(mode != 0 ? 1 : 0); with_flusher++){
+            struct simulation sim;
+            init_simulation(&sim, policy, num_frames, 0);
+            struct flusher fl;
+            if(with_flusher == 1){
+                init_flusher(&fl, mode, num_frames, period, expire, high, low);
+                sim.flusher = &fl;
+            }
+            policy->run(&sim, total_accesses);
+            print_writeback_row(&sim, with_flusher == 1 ? flusher_name : "none", &cost);
+            if(with_flusher == 1) free_flusher(&fl);
+            free_simulation(&sim);
+        }
+    }
+    free(strategies);
+    free(run_policies);
+    return 0;
+}
+
+// synthetic trace generators for benchmarking, all of them write 30% of the time
+// zipf: pages drawn from a Zipf distribution (exponent 1) over the given number of pages
+// scan: a sequential pass over the whole vpn space from vpn 0, so pages are only touched
+//       again once it wraps; skips the scattered pages zipf and loop use when there's room
+// loop: the given number of scattered pages touched in order, over and over
+// mixed: phases of BENCH_PHASE_LENGTH accesses cycling through zipf, scan and loop
+// the vpn space is the one -addrbits and -pagesize give, up to 63 bit page numbers
+#define BENCH_PHASE_LENGTH 100000
+#define BENCH_WRITE_PERCENT 30
+
+struct trace_generator {
+    char* kind;
+    int num_pages;
+    // cumulative Zipf probabilities by rank, for zipf and mixed
+    double* zipf_cdf;
+    // all ones over the vpn bits
+    unsigned long long vpn_mask;
+    // next vpn scan looks at
+    unsigned long long scan_vpn;
+    int loop_position;
+    struct random_data rng;
+    char rng_state[128];
+};
+
+double generator_uniform(struct trace_generator* gen){
+    int32_t r;
+    random_r(&gen->rng, &r);
+    return (double)r / ((double)RAND_MAX + 1.0);
+}
+
+// ranks are scattered over the vpn space so hot pages aren't neighbours
+unsigned long long scatter_page(struct trace_generator* gen, int rank){
+    return ((unsigned long long)rank * 0x9E3779B97F4A7C15ULL) & gen->vpn_mask;
+}
+
+unsigned long long generate_zipf(struct trace_generator* gen){
+    double u = generator_uniform(gen);
+    int lo = 0;
+    int hi = gen->num_pages - 1;
+    while(lo < hi){
+        int mid = (lo + hi) / 2;
+        if(gen->zipf_cdf[mid] < u) lo = mid + 1;
+        else hi = mid;
+    }
+    return scatter_page(gen, lo);
+}
+
+// the rank scatter_page maps to vpn, 0xF1DE83E19937733D is the inverse of
+// 0x9E3779B97F4A7C15 mod 2^64
+unsigned long long scattered_rank(struct trace_generator* gen, unsigned long long vpn){
+    return (vpn * 0xF1DE83E19937733DULL) & gen->vpn_mask;
+}
+
+unsigned long long generate_scan(struct trace_generator* gen){
+    // with more than half the vpn space in use scan can't avoid the scattered pages
+    if((unsigned long long)gen->num_pages * 2 - 1 <= gen->vpn_mask){
+        while(scattered_rank(gen, gen->scan_vpn) < (unsigned long long)gen->num_pages){
+            gen->scan_vpn = (gen->scan_vpn + 1) & gen->vpn_mask;
+        }
+    }
+    unsigned long long vpn = gen->scan_vpn;
+    gen->scan_vpn = (vpn + 1) & gen->vpn_mask;
+    return vpn;
+}
+
+unsigned long long generate_loop(struct trace_generator* gen){
+    unsigned long long vpn = scatter_page(gen, gen->loop_position);
+    gen->loop_position = (gen->loop_position + 1) % gen->num_pages;
+    return vpn;
+}
+
+void init_generator(struct trace_generator* gen, char* kind, int num_pages, int seed){
+    memset(gen, 0, sizeof(struct trace_generator));
+    if(strcmp(kind, "zipf")!=0 && strcmp(kind, "scan")!=0 && strcmp(kind, "loop")!=0 && strcmp(kind, "mixed")!=0){
+        printf("Unknown trace kind %s, use zipf, scan, loop or mixed \n", kind);
+        exit(1);
+    }
+    int vpn_bits = addr_size - page_frame_size;
+    gen->vpn_mask = (1ULL << vpn_bits) - 1;
+    if(num_pages<=0 || (unsigned long long)num_pages - 1 > gen->vpn_mask){
+        printf("Number of pages must be between 1 and %llu \n", gen->vpn_mask + 1);
+        exit(1);
+    }
+    gen->kind = kind;
+    gen->num_pages = num_pages;
+    initstate_r(seed, gen->rng_state, sizeof(gen->rng_state), &gen->rng);
+    if(strcmp(kind, "zipf")==0 || strcmp(kind, "mixed")==0){
+        gen->zipf_cdf = (double*)malloc(num_pages * sizeof(double));
+        double sum = 0;
+        for(int k=0; k<num_pages; k++){
+            sum += 1.0 / (k + 1);
+            gen->zipf_cdf[k] = sum;
+        }
+        for(int k=0; k<num_pages; k++){
+            gen->zipf_cdf[k] /= sum;
+        }
+    }
+}
+
+// the access_idx'th access of the trace, packed like a binary trace record
+unsigned long long generate_access(struct trace_generator* gen, long long access_idx){
+    unsigned long long vpn;
+    char* kind = gen->kind;
+    if(strcmp(kind, "mixed")==0){
+        int phase = (int)((access_idx / BENCH_PHASE_LENGTH) % 3);
+        vpn = phase == 0 ? generate_zipf(gen) : phase == 1 ? generate_scan(gen) : generate_loop(gen);
+    }else if(kind[0] == 'z'){
+        vpn = generate_zipf(gen);
+    }else if(kind[0] == 's'){
+        vpn = generate_scan(gen);
+    }else{
+        vpn = generate_loop(gen);
+    }
+    int read = generator_uniform(gen) * 100 >= BENCH_WRITE_PERCENT;
+    return pack_record(vpn, read);
+}
+
+// frames -gen <zipf|scan|loop|mixed> <accesses> <binary trace> [pages] [seed]
+// streams a synthetic trace straight to disk, so memory use doesn't grow with its length
+int run_generate(int argc, char** argv){
+    char* kind = argv[2];
+    long long total = atoll(argv[3]);
+    char* out_file_name = argv[4];
+    int num_pages = argc>=6 ? atoi(argv[5]) : 65536;
+    int seed = argc>=7 ? atoi(argv[6]) : 5635;
+    if(total<0 || total>0x7fffffff){
+        printf("Number of accesses must be between 0 and %d \n", 0x7fffffff);
+        exit(1);
+    }
+    struct trace_generator gen;
+    init_generator(&gen, kind, num_pages, seed);
+    FILE* out = fopen(out_file_name, "wb");
+    if(out==NULL){
+        printf("Could not open %s for writing, exiting.. \n", out_file_name);
+        exit(1);
+    }
+    write_trace_header(out, (int)total, 0);
+    unsigned char block[8 * 4096];
+    int in_block = 0;
+    for(long long j=0; j<total; j++){
+        put_u64(block + 8 * in_block, generate_access(&gen, j));
+        in_block++;
+        if(in_block == 4096){
+            fwrite(block, 8, in_block, out);
+            in_block = 0;
+        }
+    }
+    fwrite(block, 8, in_block, out);
+    if(fclose(out) != 0){
+        printf("Could not write %s, exiting.. \n", out_file_name);
+        exit(1);
+    }
+    free(gen.zipf_cdf);
+    printf("Wrote %lld %s accesses over %d pages to %s \n", total, kind, num_pages, out_file_name);
+    return 0;
+}
+
+double seconds_since(struct timespec* start){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// frames -bench <trace file> <frames,frames,...> [strategy,strategy,...]
+// runs every strategy (or the listed ones) at every frame count one after another
+// and prints csv with the simulation speed; the time includes setting up the
+// frames and, for every OPT row, building next_use, but not loading the trace.
+// peak_rss_kb is the high-water mark of the child the row runs in, which starts out
+// holding the loaded trace, so rows don't inherit each other's peaks
+int run_bench(int argc, char** argv){
+    char* trace_file_name = argv[2];
+    char** frame_items;
+    int num_frame_counts = split_list(argv[3], &frame_items);
+    int num_policies = sizeof(policies) / sizeof(policies[0]);
+    const struct policy** bench_policies = (const struct policy**)malloc(num_policies * sizeof(struct policy*));
+    int num_bench_policies = 0;
+    char** strategies = NULL;
+    if(argc>=5){
+        int num_strategies = split_list(argv[4], &strategies);
+        for(int s=0; s<num_strategies; s++){
+            bench_policies[num_bench_policies] = find_policy(strategies[s]);
+            if(bench_policies[num_bench_policies] == NULL){
+                printf("Unknown strategy entered, exiting .... \n");
+                exit(1);
+            }
+            num_bench_policies++;
+        }
+    }else{
+        for(int p=0; p<num_policies; p++){
+            bench_policies[num_bench_policies++] = &policies[p];
+        }
+    }
+    int total_accesses = load_trace(trace_file_name);
+    printf("strategy,frames,accesses,seconds,accesses_per_sec,ns_per_access,misses,peak_rss_kb\n");
+    for(int p=0; p<num_bench_policies; p++){
+        const struct policy* policy = bench_policies[p];
+        for(int f=0; f<num_frame_counts; f++){
+            int num_frames = atoi(frame_items[f]);
+            if(num_frames<=0){
+                printf("Invalid number of frames \n");
+                exit(1);
+            }
+            // each row runs in its own child so its peak isn't the peak of the rows before it
+            fflush(stdout);
+            pid_t child = fork();
+            if(child < 0){
+                printf("Could not fork, exiting.. \n");
+                exit(1);
+            }
+            if(child > 0){
+                int status;
+                waitpid(child, &status, 0);
+                if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+                    printf("Benchmark of %s at %d frames failed, exiting.. \n", policy->name, num_frames);
+                    exit(1);
+                }
+                continue;
+            }
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            struct simulation sim;
+            init_simulation(&sim, policy, num_frames, 0);
+            // rebuilt for every row so each OPT row pays for it, not just the first
+            if(policy->needs_next_use==1){
+                free(next_use);
+                build_next_use(total_accesses);
+            }
+            policy->run(&sim, total_accesses);
+            double seconds = seconds_since(&start);
+            free_simulation(&sim);
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            printf("%s,%d,%d,%.6f,%.0f,%.2f,%d,%ld\n", policy->name, num_frames, total_accesses, seconds,
+                seconds > 0 ? total_accesses / seconds : 0.0, total_accesses > 0 ? seconds * 1e9 / total_accesses : 0.0,
+                sim.misses, usage.ru_maxrss);
+            fflush(stdout);
+            _exit(0);
+        }
+    }
+    free(frame_items);
+    free(strategies);
+    free(bench_policies);
+    return 0;
+}
+
+// frames -stream <trace file|-> <number of frames> <strategy> [-batch N] [-lookahead N] [-every N] [-verbose] [-eventlog <file>]
+// simulates a trace of any length from stdin ("-"), a pipe or a file, holding at most
+// batch + lookahead accesses in memory. the lookahead is only kept for OPT, which
+// then decides with the next use of every page inside that window; evictions where
+// two or more resident pages had no use in the window are counted, as those are the
+// only ones where it can choose differently from OPT over the whole trace.
+// running totals are printed every -every accesses
+#define STREAM_DEFAULT_BATCH (1 << 20)
+#define STREAM_DEFAULT_EVERY 10000000
+
+void print_stream_progress(long long accesses, long long misses, long long interval_accesses, long long interval_misses){
+    printf("After %lld accesses: %lld misses, miss rate %.6f, last %lld accesses %.6f \n", accesses, misses,
+        accesses > 0 ? (double)misses / accesses : 0.0,
+        interval_accesses, interval_accesses > 0 ? (double)interval_misses / interval_accesses : 0.0);
+}
+
+int run_stream(int argc, char** argv){
+    char* trace_file_name = argv[2];
+    int num_frames = atoi(argv[3]);
+    if(num_frames<=0){
+        printf("Invalid number of frames \n");
+        exit(1);
+    }
+    const struct policy* policy = find_policy(argv[4]);
+    if(policy == NULL){
+        printf("Unknown strategy entered, exiting .... \n");
+        exit(1);
+    }
+    int batch = STREAM_DEFAULT_BATCH;
+    int lookahead = STREAM_DEFAULT_BATCH;
+    long long every = STREAM_DEFAULT_EVERY;
+    int is_verbose = 0;
+    char* event_log_name = NULL;
+    for(int a=5; a<argc; a++){
+        if(strcmp(argv[a], "-verbose")==0){
+            is_verbose = 1;
+        }else if(strcmp(argv[a], "-eventlog")==0 && a+1<argc){
+            event_log_name = argv[++a];
+        }else if(strcmp(argv[a], "-batch")==0 && a+1<argc){
+            batch = atoi(argv[++a]);
+        }else if(strcmp(argv[a], "-lookahead")==0 && a+1<argc){
+            lookahead = atoi(argv[++a]);
+        }else if(strcmp(argv[a], "-every")==0 && a+1<argc){
+            every = atoll(argv[++a]);
+        }
+    }
+    if(batch<=0 || lookahead<0 || every<=0 || (long long)batch + lookahead > 0x7fffffff){
+        printf("Invalid batch, lookahead or reporting interval \n");
+        exit(1);
+    }
+    if(policy->needs_next_use==0) lookahead = 0;
+    FILE* in = stdin;
+    if(strcmp(trace_file_name, "-")!=0){
+        in = fopen(trace_file_name, "rb");
+        if(in==NULL){
+            printf("File not found, exiting.. \n");
+            exit(1);
+        }
+    }
+    struct trace_stream* ts = (struct trace_stream*)malloc(sizeof(struct trace_stream));
+    open_trace_stream(ts, in);
+    int capacity = batch + lookahead;
+    parsed_lines = (struct parsed_line*)malloc(capacity * sizeof(struct parsed_line));
+    struct simulation sim;
+    init_simulation(&sim, policy, num_frames, is_verbose);
+    FILE* event_log_file = NULL;
+    if(event_log_name != NULL){
+        event_log_file = open_event_log_file(&sim, event_log_name);
+    }
+    // the simulation counters are int and reset after every batch, the totals are kept here
+    long long accesses = 0;
+    long long misses = 0;
+    long long writes_to_disk = 0;
+    long long drops_non_dirty = 0;
+    long long blind_evictions = 0;
+    long long reported_accesses = 0;
+    long long reported_misses = 0;
+    int filled = 0;
+    while(1){
+        filled += read_stream_batch(ts, parsed_lines + filled, capacity - filled, policy->needs_next_use);
+        if(filled == 0) break;
+        // batches end exactly on the reporting points
+        long long until_report = every - accesses % every;
+        int step = filled < batch ? filled : batch;
+        if(until_report < step) step = (int)until_report;
+        if(policy->needs_next_use==1){
+            free(next_use);
+            build_next_use(filled);
+            sim.opt_horizon = ts->finished == 1 ? 0 : filled;
+            opt_rekey(&sim, filled);
+        }
+        policy->run(&sim, step);
+        accesses += sim.mem_accesses;
+        misses += sim.misses;
+        writes_to_disk += sim.writes_to_disk;
+        drops_non_dirty += sim.drops_non_dirty;
+        blind_evictions += sim.opt_blind_evictions;
+        sim.mem_accesses = 0;
+        sim.misses = 0;
+        sim.writes_to_disk = 0;
+        sim.drops_non_dirty = 0;
+        sim.evictions = 0;
+        sim.opt_blind_evictions = 0;
+        filled -= step;
+        memmove(parsed_lines, parsed_lines + step, filled * sizeof(struct parsed_line));
+        if(accesses % every == 0){
+            if(sim.event_log != NULL) flush_event_log(sim.event_log);
+            print_stream_progress(accesses, misses, accesses - reported_accesses, misses - reported_misses);
+            reported_accesses = accesses;
+            reported_misses = misses;
+        }
+    }
+    if(sim.event_log != NULL) flush_event_log(sim.event_log);
+    if(accesses != reported_accesses){
+        print_stream_progress(accesses, misses, accesses - reported_accesses, misses - reported_misses);
+    }
+    printf("Number of memory accesses: %lld\nNumber of misses: %lld\nNumber of writes: %lld\nNumber of drops: %lld\n",
+        accesses, misses, writes_to_disk, drops_non_dirty);
+    if(policy->needs_next_use==1){
+        printf("OPT lookahead %d accesses, evictions that could differ from OPT: %lld \n", lookahead, blind_evictions);
+    }
+    if(in != stdin) fclose(in);
+    free(ts);
+    free_simulation(&sim);
+    if(event_log_file != NULL) fclose(event_log_file);
+    return 0;
+}
+
+// -pagesize <bytes>, -addrbits <bits> and -pageids <bits> work with every mode, they are taken out of
+// argv before the mode is picked
+void parse_page_options(int* argc, char** argv){
+    int kept = 1;
+    for(int a=1; a<*argc; a++){
+        if(strcmp(argv[a], "-pagesize")==0 && a+1<*argc){
+            long long page_size = atoll(argv[++a]);
+            page_frame_size = 0;
+            while((1LL << page_frame_size) < page_size && page_frame_size < 40) page_frame_size++;
+            if(page_size <= 1 || (1LL << page_frame_size) != page_size){
+                printf("Page size must be a power of two, exiting.. \n");
+                exit(1);
+            }
+        }else if(strcmp(argv[a], "-addrbits")==0 && a+1<*argc){
+            addr_size = atoi(argv[++a]);
+        }else if(strcmp(argv[a], "-pageids")==0 && a+1<*argc){
+            page_id_bits = atoi(argv[++a]);
+            if(page_id_bits < 1 || page_id_bits > 30){
+                printf("-pageids takes between 1 and 30 bits, exiting.. \n");
+                exit(1);
+            }
+        }else{
+            argv[kept++] = argv[a];
+        }
+    }
+    *argc = kept;
+    argv[kept] = NULL;
+    if(addr_size > 64 || addr_size <= page_frame_size){
+        printf("Addresses must be wider than the page offset and at most 64 bits, exiting.. \n");
+        exit(1);
+    }
+    configure_pages();
+}
+
+int main(int argc, char** argv)
+{
+    parse_page_options(&argc, argv);
+    char* verbose = "-verbose";
+    // frames -convert <text trace> <binary trace> [-varint] writes a binary trace and exits
+    if(argc>=4 && strcmp(argv[1], "-convert")==0){
+        convert_trace(argv[2], argv[3], argc==5 && strcmp(argv[4], "-varint")==0);
+        return 0;
+    }
+    if(argc>=5 && strcmp(argv[1], "-sweep")==0){
+        return run_sweep(argc, argv);
+    }
+    if(argc>=4 && strcmp(argv[1], "-mrc")==0){
+        return run_miss_ratio_curve(argc, argv);
+    }
+    if(argc>=5 && strcmp(argv[1], "-shards")==0){
+        return run_sampled_miss_ratio_curve(argc, argv);
+    }
+    if(argc>=5 && strcmp(argv[1], "-gen")==0){
+        return run_generate(argc, argv);
+    }
+    if(argc>=4 && strcmp(argv[1], "-bench")==0){
+        return run_bench(argc, argv);
+    }
+    if(argc>=5 && strcmp(argv[1], "-writeback")==0){
+        return run_writeback(argc, argv);
+    }
+    if(argc>=4 && strcmp(argv[1], "-hugepages")==0){
+        return run_huge_pages(argc, argv);
+    }
+    if(argc>=6 && strcmp(argv[1], "-tenants")==0){
+        return run_tenants(argc, argv);
+    }
+    if(argc>=5 && strcmp(argv[1], "-stream")==0){
+        return run_stream(argc, argv);
+    }
+    if(argc<4){
+        printf("Usage: %s <trace file> <number of frames> <OPT|FIFO|CLOCK|LRU|RANDOM|ARC|2Q|CLOCKPRO|CLOCKPRO-FIFO> [-verbose] [-eventlog <file>] [-stats <json file|->] [-window <accesses>] \n", argv[0]);
+        printf("       %s -convert <text trace> <binary trace> [-varint] \n", argv[0]);
+        printf("       %s -sweep <trace file> <frames,frames,...> <strategy,strategy,...> [threads] \n", argv[0]);
+        printf("       %s -mrc <trace file> <max frames> [LRU|OPT|LRU,OPT] \n", argv[0]);
+        printf("       %s -shards <trace file> <max frames> <sampling rate> [max sampled pages] [-exact] \n", argv[0]);
+        printf("       %s -gen <zipf|scan|loop|mixed> <accesses> <binary trace> [pages] [seed] \n", argv[0]);
+        printf("       %s -bench <trace file> <frames,frames,...> [strategy,strategy,...] \n", argv[0]);
+        printf("       %s -stream <trace file|-> <number of frames> <strategy> [-batch N] [-lookahead N] [-every N] [-verbose] [-eventlog <file>] \n", argv[0]);
+        printf("       %s -tenants <asid trace> <number of frames> <strategy> <global|partition|wss> [-quota q,q,...] [-tau N] \n", argv[0]);
+        printf("       %s -hugepages <trace file> <number of frames> [promotion threshold] \n", argv[0]);
+        printf("       %s -writeback <trace file> <number of frames> <strategy,strategy,...|all> [-flush periodic|watermark] [-period N] [-expire N] [-high percent] [-low percent] [-cost read,write,batch,batch page] \n", argv[0]);
+        printf("       any mode also takes -pagesize <bytes> (default 4096), -addrbits <bits> (default 32, up to 64) and -pageids <bits> (at most 1 << bits distinct pages once addresses are wider than that, default 22) \n");
+        exit(1);
+    }
+    // 2nd argument will be the name of the trace file 
+    char* trace_file_name = argv[1];
+    int num_frames = atoi(argv[2]);
+    if(num_frames<=0){
+        printf("Invalid number of frames \n");
+        exit(1);
+    }
+    const struct policy* policy = find_policy(argv[3]);
+    if(policy == NULL){
+        printf("Unknown strategy entered, exiting .... \n");
+        exit(1);
+    }
+    int is_verbose = 0;
+    // -stats <json file> collects the counters in struct sim_stats, "-" prints them after the totals
+    char* stats_file_name = NULL;
+    // -eventlog <file> writes the evictions -verbose would print as binary records instead
+    char* event_log_name = NULL;
+    int window = STATS_DEFAULT_WINDOW;
+    // verbose and the stats options come after the strategy, in any order
+    // sanity check to check if it is indeed verbose, set verbose flag to true
+    for(int a=4; a<argc; a++){
+        if(strcmp(verbose, argv[a])==0){
+            is_verbose = 1;
+        }else if(strcmp(argv[a], "-stats")==0 && a+1<argc){
+            stats_file_name = argv[++a];
+        }else if(strcmp(argv[a], "-eventlog")==0 && a+1<argc){
+            event_log_name = argv[++a];
+        }else if(strcmp(argv[a], "-window")==0 && a+1<argc){
+            window = atoi(argv[++a]);
+            if(window<=0){
+                printf("Invalid window size \n");
+                exit(1);
+            }
+        }
+    }
+    // printf("Is verbose %d \n", is_verbose);
+    int total_accesses = load_trace(trace_file_name);
+    struct simulation sim;
+    init_simulation(&sim, policy, num_frames, is_verbose);
+    FILE* event_log_file = NULL;
+    if(event_log_name != NULL){
+        event_log_file = open_event_log_file(&sim, event_log_name);
+    }
+    struct sim_stats stats;
+    if(stats_file_name != NULL){
+        init_stats(&stats, total_accesses, window);
+        sim.stats = &stats;
+    }
+    if(policy->needs_next_use==1){
+        build_next_use(total_accesses);
+    }
+    policy->run(&sim, total_accesses);
+    if(sim.event_log != NULL) flush_event_log(sim.event_log);
+    print_state(sim.mem_accesses, sim.misses, sim.writes_to_disk, sim.drops_non_dirty);
+    // printf("Evictions %d \n", sim.evictions);
+    if(stats_file_name != NULL){
+        FILE* out = strcmp(stats_file_name, "-")==0 ? stdout : fopen(stats_file_name, "w");
+        if(out==NULL){
+            printf("Could not open %s for writing, exiting.. \n", stats_file_name);
+            exit(1);
+        }
+        print_stats_json(out, &sim, total_accesses);
+        if(out != stdout) fclose(out);
+        free_stats(&stats);
+    }
+    free_simulation(&sim);
+    if(event_log_file != NULL) fclose(event_log_file);
+    return 0;
+}